@@ -1,8 +1,45 @@
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "Bfinders.h"
 #include "cubiomes/util.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if __GNUC__
+#define POPCOUNT64(X)           __builtin_popcountll(X)
+#define CTZ64(X)                __builtin_ctzll(X)
+#elif _MSC_VER
+#include <intrin.h>
+#define POPCOUNT64(X)           ((int)__popcnt64(X))
+static inline int CTZ64(uint64_t x) {
+	unsigned long i;
+	_BitScanForward64(&i, x);
+	return (int)i;
+}
+#else
+static inline int POPCOUNT64(uint64_t x) {
+	x = x - ((x >> 1) & UINT64_C(0x5555555555555555));
+	x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+	x = (x + (x >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+	return (int)((x * UINT64_C(0x0101010101010101)) >> 56);
+}
+static inline int CTZ64(uint64_t x) {
+	return POPCOUNT64((x & -x) - 1);
+}
+#endif
+
 
 bool getBedrockStructureConfig(const int structureType, const int mc, StructureConfig *sconf) {
 	static const StructureConfig
@@ -99,12 +136,18 @@ bool getBedrockStructurePos(int structureType, int mc, uint64_t seed, int regX,
 	case Jungle_Pyramid:
 	case Ruined_Portal:
 	case Swamp_Hut:
-	case Bastion:
-	case Fortress:
 	case Ruined_Portal_N:
 		*pos = getBedrockFeaturePos(&sconf, seed, regX, regZ);
 		return true;
 
+	case Bastion:
+	case Fortress: {
+		*pos = getBedrockFeaturePos(&sconf, seed, regX, regZ);
+		BedrockSeedCalls sc;
+		initBedrockSeedCalls(&sc, seed);
+		return isBedrockBastion(&sc, pos->x >> 4, pos->z >> 4) == (structureType == Bastion);
+	}
+
 	case Ancient_City:
 	case Mansion:
 	case Monument:
@@ -130,14 +173,6 @@ bool getBedrockStructurePos(int structureType, int mc, uint64_t seed, int regX,
 	// 	mSetSeed(&treasureMt, pos->x*UINT64_C(341873128712) + pos->z*UINT64_C(132897987541) + seed + sconf.salt, 1);
 	// 	return mNextFloat(&treasureMt) < 0.01;
 
-	// case Bastion:
-	// 	*pos = getBedrockFeaturePos(&sconf, seed, regX, regZ);
-	// 	MersenneTwister bastionMt;
-	// 	mSetSeed(&bastionMt, seed, 2);
-	// 	uint64_t call1 = mNextIntUnbound(&bastionMt);
-	// 	mSetSeed(&bastionMt, (call1 * (pos->x >> 4)) ^ (mNextIntUnbound(&bastionMt) * (pos->z >> 4)) ^ seed, 1);
-	// 	return mNextInt(&bastionMt, 5) >= 2;
-
 	default:
 		fprintf(stderr, "ERROR: getStructurePos: unsupported structure type %s\n", struct2str(structureType));
 		exit(1);
@@ -182,27 +217,575 @@ int getRavinePos(int mc, uint64_t seed, int x, int z, const Generator *g, Struct
 	}
 }
 
- bool getBedrockRavinePos(uint64_t seed, int x, int z, StructureVariant *ravine) {
+void initBedrockSeedCalls(BedrockSeedCalls *sc, uint64_t seed) {
 	MersenneTwister mt;
 	mSetSeed(&mt, seed, 2);
-	uint32_t call1 = mNextIntUnbound(&mt);
-	mSetSeed(&mt, (seed ^ x*(call1 | 1)) + z*(mNextIntUnbound(&mt) | 1), 1 + 10*!!ravine);
-	if (mNextInt(&mt, 150)) return false;
- 	if (ravine) {
+	sc->seed = seed;
+	sc->call1 = mNextIntUnbound(&mt);
+	sc->call2 = mNextIntUnbound(&mt);
+}
+
+bool getBedrockRavinePosSeeded(const BedrockSeedCalls *sc, int x, int z, StructureVariant *ravine) {
+	uint64_t chunkSeed = (sc->seed ^ x*(sc->call1 | 1)) + z*(sc->call2 | 1);
+	// Only the first output decides if there is a ravine (1 in 150 chunks)
+	if (mFirst(chunkSeed) % 150) return false;
+	if (ravine) {
+		MersenneTwister mt;
+		mSetSeed(&mt, chunkSeed, 11);
+		mNextInt(&mt, 150);
 		ravine->x = 16*x + mNextInt(&mt, 16);
 		ravine->y = 20   + mNextInt(&mt, mNextInt(&mt, 40) + 8);
-	mNextIntUnbound(&mt);
-	ravine->z = 16*z + mNextInt(&mt, 16);
+		mNextIntUnbound(&mt);
+		ravine->z = 16*z + mNextInt(&mt, 16);
+		mNextFloat(&mt);
 		mNextFloat(&mt);
-	mNextFloat(&mt);
 		ravine->size = 3*(mNextFloat(&mt) + mNextFloat(&mt));
+		ravine->giant = 0;
 		if (mNextFloat(&mt) < .05) {
- 		ravine->giant = 1;
- 			ravine->size *= 2;
+			ravine->giant = 1;
+			ravine->size *= 2;
 		}
 	}
 	return true;
- }
+}
+
+bool getBedrockRavinePos(uint64_t seed, int x, int z, StructureVariant *ravine) {
+	BedrockSeedCalls sc;
+	initBedrockSeedCalls(&sc, seed);
+	return getBedrockRavinePosSeeded(&sc, x, z, ravine);
+}
+
+// mFirstTwo() for MT_LANES seeds at once, in a form compilers vectorize. The lanes are independent
+// dependency chains, enough of them to hide the multiply latency.
+enum { MT_LANES = 64 };
+static void mFirstTwoLanes(const uint32_t seeds[MT_LANES], uint32_t out1[MT_LANES], uint32_t out2[MT_LANES]) {
+	uint32_t a[MT_LANES], a1[MT_LANES], a2[MT_LANES], a397[MT_LANES];
+	int l;
+	for (l = 0; l < MT_LANES; l++)
+		a1[l] = 1812433253u * (seeds[l] ^ (seeds[l] >> 30)) + 1;
+	for (l = 0; l < MT_LANES; l++)
+		a[l] = a2[l] = 1812433253u * (a1[l] ^ (a1[l] >> 30)) + 2;
+	for (uint32_t k = 3; k <= 397; k++) {
+		for (l = 0; l < MT_LANES; l++)
+			a[l] = 1812433253u * (a[l] ^ (a[l] >> 30)) + k;
+	}
+	for (l = 0; l < MT_LANES; l++) {
+		a397[l] = a[l];
+		a[l] = 1812433253u * (a[l] ^ (a[l] >> 30)) + 398;
+	}
+	for (l = 0; l < MT_LANES; l++) {
+		uint32_t v1 = (seeds[l] & 0x80000000) | (a1[l] & 0x7fffffff);
+		uint32_t v2 = (a1[l] & 0x80000000) | (a2[l] & 0x7fffffff);
+		v1 = a397[l] ^ (v1 >> 1) ^ (v1 & 1 ? 2567483615u : 0);
+		v2 = a[l]    ^ (v2 >> 1) ^ (v2 & 1 ? 2567483615u : 0);
+		v1 ^= v1 >> 11;
+		v1 ^= (v1 << 7) & 2636928640u;
+		v1 ^= (v1 << 15) & 4022730752u;
+		v2 ^= v2 >> 11;
+		v2 ^= (v2 << 7) & 2636928640u;
+		v2 ^= (v2 << 15) & 4022730752u;
+		out1[l] = v1 ^ (v1 >> 18);
+		out2[l] = v2 ^ (v2 >> 18);
+	}
+}
+
+// mFirst() for MT_LANES seeds at once, for scans that only test the first output
+static void mFirstLanes(const uint32_t seeds[MT_LANES], uint32_t out[MT_LANES]) {
+	uint32_t a[MT_LANES], a1[MT_LANES];
+	int l;
+	for (l = 0; l < MT_LANES; l++)
+		a[l] = a1[l] = 1812433253u * (seeds[l] ^ (seeds[l] >> 30)) + 1;
+	for (uint32_t k = 2; k <= 397; k++) {
+		for (l = 0; l < MT_LANES; l++)
+			a[l] = 1812433253u * (a[l] ^ (a[l] >> 30)) + k;
+	}
+	for (l = 0; l < MT_LANES; l++) {
+		uint32_t v = (seeds[l] & 0x80000000) | (a1[l] & 0x7fffffff);
+		v = a[l] ^ (v >> 1) ^ (v & 1 ? 2567483615u : 0);
+		v ^= v >> 11;
+		v ^= (v << 7) & 2636928640u;
+		v ^= (v << 15) & 4022730752u;
+		out[l] = v ^ (v >> 18);
+	}
+}
+
+int getBedrockRavinesInArea(const BedrockSeedCalls *sc, int x0, int z0, int x1, int z1, StructureVariant *out, int maxOut) {
+	int z, n = 0;
+	for (z = z0; z <= z1; ++z) {
+		// The 1 in 150 test runs on a row segment of chunks at once; only hits get a full twister
+		for (int x = x0; x <= x1; x += MT_LANES) {
+			uint32_t seeds[MT_LANES], first[MT_LANES];
+			int l;
+			for (l = 0; l < MT_LANES; l++)
+				seeds[l] = (uint32_t)((sc->seed ^ (x + l)*(sc->call1 | 1)) + z*(sc->call2 | 1));
+			mFirstLanes(seeds, first);
+			for (l = 0; l < MT_LANES && x + l <= x1; l++) {
+				if (first[l] % 150) continue;
+				if (n < maxOut) getBedrockRavinePosSeeded(sc, x + l, z, out + n);
+				++n;
+			}
+		}
+	}
+	return n;
+}
+
+bool isBedrockBastion(const BedrockSeedCalls *sc, int chunkX, int chunkZ) {
+	uint64_t chunkSeed = (sc->call1 * (uint64_t)chunkX) ^ (sc->call2 * chunkZ) ^ sc->seed;
+	return mFirst(chunkSeed) % 5 >= 2;
+}
+
+bool allocSlimeBitmap(SlimeBitmap *sb, int x0, int z0, int w, int h) {
+	memset(sb, 0, sizeof(*sb));
+	if (w <= 0 || h <= 0) return false;
+	sb->x0 = x0;
+	sb->z0 = z0;
+	sb->w = w;
+	sb->h = h;
+	sb->stride = (w + 63) / 64;
+	sb->bits = (uint64_t*) calloc((size_t)sb->stride * h, sizeof(uint64_t));
+	return sb->bits != NULL;
+}
+
+void fillSlimeBitmap(SlimeBitmap *sb, int row0, int row1) {
+	for (int r = row0; r < row1; r++) {
+		uint64_t *row = sb->bits + (size_t)r * sb->stride;
+		uint32_t z = (uint32_t)(sb->z0 + r);
+		memset(row, 0, sb->stride * sizeof(uint64_t));
+
+		for (int i = 0; i < sb->w; i += MT_LANES) {
+			uint32_t seeds[MT_LANES], first[MT_LANES], second[MT_LANES];
+			int l;
+			for (l = 0; l < MT_LANES; l++)
+				seeds[l] = ((uint32_t)(sb->x0 + i + l) * 0x1f1f1f1fu) ^ z;
+			mFirstTwoLanes(seeds, first, second);
+			for (l = 0; l < MT_LANES && i + l < sb->w; l++) {
+				if (first[l] % 10 == 0)
+					row[(i + l) >> 6] |= UINT64_C(1) << ((i + l) & 63);
+			}
+		}
+	}
+}
+
+// Cache file layout: this header, then the rows of the bitmap
+STRUCT(SlimeBitmapHeader) {
+	char magic[8];
+	int32_t x0, z0, w, h, stride;
+	uint8_t reserved[36];  // keeps the rows 64-byte aligned
+};
+static const char s_slime_magic[8] = { 'B','S','L','I','M','E','0','1' };
+
+bool saveSlimeBitmap(const SlimeBitmap *sb, const char *path) {
+	SlimeBitmapHeader head;
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, s_slime_magic, sizeof(head.magic));
+	head.x0 = sb->x0;
+	head.z0 = sb->z0;
+	head.w = sb->w;
+	head.h = sb->h;
+	head.stride = sb->stride;
+
+	FILE *fp = fopen(path, "wb");
+	if (!fp) return false;
+	size_t words = (size_t)sb->stride * sb->h;
+	bool ok = fwrite(&head, sizeof(head), 1, fp) == 1 &&
+	          fwrite(sb->bits, sizeof(uint64_t), words, fp) == words;
+	return (fclose(fp) == 0) && ok;
+}
+
+// Maps a whole file of at least `minSize` bytes read-only, or returns NULL
+static uint8_t *mapFileRead(const char *path, size_t minSize, size_t *size) {
+	uint8_t *view = NULL;
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return NULL;
+	LARGE_INTEGER fsize;
+	if (GetFileSizeEx(file, &fsize) && fsize.QuadPart >= (LONGLONG)minSize) {
+		HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map) {
+			view = (uint8_t*) MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+			*size = (size_t)fsize.QuadPart;
+			CloseHandle(map);  // the view keeps the mapping alive
+		}
+	}
+	CloseHandle(file);
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t)minSize) {
+		void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (p != MAP_FAILED) {
+			view = (uint8_t*) p;
+			*size = st.st_size;
+		}
+	}
+	close(fd);
+#endif
+	return view;
+}
+
+static void unmapFile(void *view, size_t size) {
+#ifdef _WIN32
+	(void) size;
+	UnmapViewOfFile(view);
+#else
+	munmap(view, size);
+#endif
+}
+
+bool loadSlimeBitmap(SlimeBitmap *sb, const char *path, int x0, int z0, int w, int h) {
+	memset(sb, 0, sizeof(*sb));
+	size_t size = 0;
+	uint8_t *view = mapFileRead(path, sizeof(SlimeBitmapHeader), &size);
+	if (!view) return false;
+
+	sb->mapping = view;
+	sb->mappedSize = size;
+	const SlimeBitmapHeader *head = (const SlimeBitmapHeader*) view;
+	if (memcmp(head->magic, s_slime_magic, sizeof(head->magic)) != 0 ||
+		head->x0 != x0 || head->z0 != z0 || head->w != w || head->h != h ||
+		head->stride != (w + 63) / 64 ||
+		size < sizeof(*head) + (size_t)head->stride * head->h * sizeof(uint64_t)) {
+		freeSlimeBitmap(sb);
+		return false;
+	}
+	sb->x0 = x0;
+	sb->z0 = z0;
+	sb->w = w;
+	sb->h = h;
+	sb->stride = head->stride;
+	sb->bits = (uint64_t*) (view + sizeof(*head));
+	return true;
+}
+
+void freeSlimeBitmap(SlimeBitmap *sb) {
+	if (sb->mapping) {
+		unmapFile(sb->mapping, sb->mappedSize);
+	} else {
+		free(sb->bits);
+	}
+	memset(sb, 0, sizeof(*sb));
+}
+
+// Bits [x, x+n) of a bitmap row as the low bits of a word, for n <= 64
+static inline uint64_t slimeRowBits(const uint64_t *row, int x, int n) {
+	uint64_t v = row[x >> 6] >> (x & 63);
+	if ((x & 63) + n > 64) v |= row[(x >> 6) + 1] << (64 - (x & 63));
+	return n == 64 ? v : v & ((UINT64_C(1) << n) - 1);
+}
+
+// Keeps `out` sorted, best first, with no two clusters within `radius` of each other
+static int insertSlimeCluster(SlimeCluster *out, int n, int maxOut, SlimeCluster c, int radius) {
+	int i;
+	for (i = 0; i < n; i++) {
+		int dx = out[i].x - c.x, dz = out[i].z - c.z;
+		if (dx*dx + dz*dz > radius*radius) continue;
+		if (out[i].count >= c.count) return n;
+		memmove(out + i, out + i + 1, (n - i - 1) * sizeof(*out));
+		--n;
+		--i;
+	}
+	if (n == maxOut) {
+		if (out[n - 1].count >= c.count) return n;
+		--n;
+	}
+	for (i = n; i > 0 && out[i - 1].count < c.count; i--)
+		out[i] = out[i - 1];
+	out[i] = c;
+	return n + 1;
+}
+
+int findSlimeClusters(const SlimeBitmap *sb, int radius, SlimeCluster *out, int maxOut) {
+	const int R = radius;
+	if (R < 0 || R > 31 || maxOut <= 0) return 0;
+	const int cw = sb->w - 2*R, ch = sb->h - 2*R;
+	if (cw <= 0 || ch <= 0) return 0;
+
+	// half width of the circle in each row
+	int hw[63];
+	for (int dz = -R; dz <= R; dz++) {
+		int k = 0;
+		while ((k + 1) * (k + 1) + dz * dz <= R * R) k++;
+		hw[dz + R] = k;
+	}
+
+	uint16_t *counts = (uint16_t*) malloc(cw * sizeof(*counts));
+	if (!counts) return 0;
+	int n = 0;
+
+	for (int cz = R; cz < sb->h - R; cz++) {
+		memset(counts, 0, cw * sizeof(*counts));
+		// Sum the popcounts of the circle's row windows, sliding along the rows
+		for (int dz = -R; dz <= R; dz++) {
+			const uint64_t *row = sb->bits + (size_t)(cz + dz) * sb->stride;
+			int k = hw[dz + R], len = 2*k + 1;
+			for (int i = 0; i < cw; i++)
+				counts[i] += POPCOUNT64(slimeRowBits(row, i + R - k, len));
+		}
+		for (int i = 0; i < cw; i++) {
+			if (n == maxOut && counts[i] <= out[n - 1].count) continue;
+			if (counts[i] == 0) continue;
+			SlimeCluster c = { sb->x0 + i + R, sb->z0 + cz, counts[i] };
+			n = insertSlimeCluster(out, n, maxOut, c, R);
+		}
+	}
+	free(counts);
+	return n;
+}
+
+// Whether a chunk offset within the region is at most `maxOffset` chunks from the region's
+// low (hi == 0) or high (hi == 1) edge
+static inline bool nearRegionEdge(uint32_t out, int range, int hi, int maxOffset) {
+	int c = out % range;
+	return (hi ? range - 1 - c : c) <= maxOffset;
+}
+
+// Checks regions `from` to 3 of the 2x2 block with base `u`, in the order (0,0), (1,0), (0,1), (1,1).
+// Each region wants its structure in the corner facing the others.
+static bool checkQuadRegions(const StructureConfig *sconf, uint32_t u, int maxOffset, int from) {
+	const uint32_t kx = (uint32_t)UINT64_C(341873128712), kz = (uint32_t)UINT64_C(132897987541);
+	for (int i = from; i < 4; i++) {
+		int dx = i & 1, dz = i >> 1;
+		uint32_t out1, out2;
+		mFirstTwo(u + dx*kx + dz*kz, &out1, &out2);
+		if (!nearRegionEdge(out1, sconf->chunkRange, !dx, maxOffset) ||
+			!nearRegionEdge(out2, sconf->chunkRange, !dz, maxOffset))
+			return false;
+	}
+	return true;
+}
+
+bool isBedrockQuadBase(const StructureConfig *sconf, uint32_t u, int maxOffset) {
+	return checkQuadRegions(sconf, u, maxOffset, 0);
+}
+
+int scanBedrockQuadBases(const StructureConfig *sconf, int maxOffset, uint64_t start, uint64_t count, uint32_t *out, int maxOut) {
+	int n = 0;
+	for (uint64_t i = 0; i < count; i += MT_LANES) {
+		uint32_t seeds[MT_LANES], first[MT_LANES], second[MT_LANES];
+		int l;
+		for (l = 0; l < MT_LANES; l++)
+			seeds[l] = (uint32_t)(start + i + l);
+		// The first region alone rejects all but about 1 in (chunkRange / (maxOffset+1))^2 bases
+		mFirstTwoLanes(seeds, first, second);
+		for (l = 0; l < MT_LANES && i + l < count; l++) {
+			if (!nearRegionEdge(first[l], sconf->chunkRange, 1, maxOffset) ||
+				!nearRegionEdge(second[l], sconf->chunkRange, 1, maxOffset))
+				continue;
+			if (!checkQuadRegions(sconf, seeds[l], maxOffset, 1)) continue;
+			if (n < maxOut) out[n] = seeds[l];
+			++n;
+		}
+	}
+	return n;
+}
+
+bool allocProximityBitmap(ProximityBitmap *pb, int structureType, int mc, int radius) {
+	memset(pb, 0, sizeof(*pb));
+	pb->structureType = structureType;
+	pb->mc = mc;
+	pb->radius = radius;
+	pb->bits = (uint64_t*) malloc((size_t)PROXIMITY_WORDS * sizeof(uint64_t));
+	return pb->bits != NULL;
+}
+
+// Structures placed with getBedrockFeaturePos(), whose position is the first two outputs of the
+// region's Mersenne Twister
+static bool isFeaturePlaced(int structureType, int mc) {
+	switch (structureType) {
+	case Desert_Pyramid:
+	case Igloo:
+	case Jungle_Pyramid:
+	case Ruined_Portal:
+	case Swamp_Hut:
+	case Ruined_Portal_N:
+	case Bastion:
+	case Fortress:
+		return true;
+	case Shipwreck:
+		return mc > MC_1_17;
+	default:
+		return false;
+	}
+}
+
+STRUCT(ProximityRegion) {
+	int x, z;
+	int64_t centerDistSq;
+};
+
+static int compareProximityRegions(const void *a, const void *b) {
+	int64_t da = ((const ProximityRegion*)a)->centerDistSq, db = ((const ProximityRegion*)b)->centerDistSq;
+	return (da > db) - (da < db);
+}
+
+// Stores the regions that can place a structure within `radius` blocks of the origin in `regs`,
+// if not NULL, and returns their number. The regions closest to the origin come first, as they
+// are the most likely to set a seed's bit, after which the others need not be checked.
+static int proximityRegions(const StructureConfig *sconf, int radius, ProximityRegion *regs) {
+	const int64_t span = (int64_t)sconf->regionSize * 16;
+	const int64_t limit = (int64_t)(radius + 1) * (radius + 1);
+	const int r = (int)(radius / span) + 2;
+	int n = 0;
+	for (int rz = -r; rz <= r; rz++) {
+		for (int rx = -r; rx <= r; rx++) {
+			// Distance from the origin to the box of possible positions in the region
+			int64_t x0 = rx * span + 8, x1 = x0 + (sconf->chunkRange - 1) * 16;
+			int64_t z0 = rz * span + 8, z1 = z0 + (sconf->chunkRange - 1) * 16;
+			int64_t dx = x0 > 0 ? x0 : (x1 < 0 ? -x1 : 0);
+			int64_t dz = z0 > 0 ? z0 : (z1 < 0 ? -z1 : 0);
+			if (dx*dx + dz*dz >= limit) continue;
+			if (sconf->structType == End_City) {
+				// End cities are only placed from 1008 blocks out, see getBedrockStructurePos()
+				int64_t fx = x0 + x1 > 0 ? x1 : -x0, fz = z0 + z1 > 0 ? z1 : -z0;
+				if (fx*fx + fz*fz < 1008*INT64_C(1008)) continue;
+			}
+			if (regs) {
+				int64_t cx = (x0 + x1) / 2, cz = (z0 + z1) / 2;
+				regs[n].x = rx;
+				regs[n].z = rz;
+				regs[n].centerDistSq = cx*cx + cz*cz;
+			}
+			n++;
+		}
+	}
+	if (regs) qsort(regs, n, sizeof(*regs), compareProximityRegions);
+	return n;
+}
+
+void fillProximityBitmap(ProximityBitmap *pb, uint32_t start, uint64_t count) {
+	uint64_t *bits = pb->bits + (start >> 6);
+	memset(bits, 0, (size_t)(count >> 6) * sizeof(uint64_t));
+
+	StructureConfig sconf;
+	if (!getBedrockStructureConfig(pb->structureType, pb->mc, &sconf)) return;
+	int n = proximityRegions(&sconf, pb->radius, NULL);
+	ProximityRegion *regs = (ProximityRegion*) malloc((size_t)n * sizeof(*regs));
+	if (!regs) return;
+	proximityRegions(&sconf, pb->radius, regs);
+
+	const int64_t limit = (int64_t)(pb->radius + 1) * (pb->radius + 1);
+	const bool feature = isFeaturePlaced(pb->structureType, pb->mc);
+	const bool netherComplex = pb->structureType == Bastion || pb->structureType == Fortress;
+	for (uint64_t i = 0; i < count; i += MT_LANES) {
+		uint64_t word = 0;
+		for (int r = 0; r < n && word != ~UINT64_C(0); r++) {
+			int rx = regs[r].x, rz = regs[r].z;
+			int l;
+			if (feature) {
+				uint32_t seeds[MT_LANES], first[MT_LANES], second[MT_LANES];
+				uint32_t offset = (uint32_t)(rx*UINT64_C(341873128712) + rz*UINT64_C(132897987541) + sconf.salt);
+				for (l = 0; l < MT_LANES; l++)
+					seeds[l] = (uint32_t)(start + i + l) + offset;
+				mFirstTwoLanes(seeds, first, second);
+				for (l = 0; l < MT_LANES; l++) {
+					int64_t x = ((int64_t)rx * sconf.regionSize + first[l] % sconf.chunkRange) * 16 + 8;
+					int64_t z = ((int64_t)rz * sconf.regionSize + second[l] % sconf.chunkRange) * 16 + 8;
+					if (x*x + z*z >= limit || (word >> l & 1)) continue;
+					if (netherComplex) {
+						// Only the complexes in range need the costlier bastion or fortress check
+						BedrockSeedCalls sc;
+						initBedrockSeedCalls(&sc, (uint64_t)(int64_t)(int32_t)(start + i + l));
+						if (isBedrockBastion(&sc, (int)(x >> 4), (int)(z >> 4)) != (pb->structureType == Bastion))
+							continue;
+					}
+					word |= UINT64_C(1) << l;
+				}
+			} else {
+				for (l = 0; l < MT_LANES; l++) {
+					if (word >> l & 1) continue;
+					Pos p;
+					uint64_t seed = (uint64_t)(int64_t)(int32_t)(start + i + l);
+					if (getBedrockStructurePos(pb->structureType, pb->mc, seed, rx, rz, &p) &&
+						(int64_t)p.x*p.x + (int64_t)p.z*p.z < limit)
+						word |= UINT64_C(1) << l;
+				}
+			}
+		}
+		bits[i >> 6] = word;
+	}
+	free(regs);
+}
+
+// File layout: this header, then the PROXIMITY_WORDS words of the bitmap
+STRUCT(ProximityBitmapHeader) {
+	char magic[8];
+	int32_t structureType, mc, radius;
+	uint8_t reserved[44];  // keeps the bits 64-byte aligned
+};
+static const char s_proximity_magic[8] = { 'B','P','R','O','X','0','0','1' };
+
+bool saveProximityBitmap(const ProximityBitmap *pb, const char *path) {
+	ProximityBitmapHeader head;
+	memset(&head, 0, sizeof(head));
+	memcpy(head.magic, s_proximity_magic, sizeof(head.magic));
+	head.structureType = pb->structureType;
+	head.mc = pb->mc;
+	head.radius = pb->radius;
+
+	FILE *fp = fopen(path, "wb");
+	if (!fp) return false;
+	bool ok = fwrite(&head, sizeof(head), 1, fp) == 1 &&
+	          fwrite(pb->bits, sizeof(uint64_t), PROXIMITY_WORDS, fp) == PROXIMITY_WORDS;
+	return (fclose(fp) == 0) && ok;
+}
+
+bool loadProximityBitmap(ProximityBitmap *pb, const char *path, int structureType, int mc, int radius) {
+	memset(pb, 0, sizeof(*pb));
+	size_t size = 0;
+	uint8_t *view = mapFileRead(path, sizeof(ProximityBitmapHeader) + (size_t)PROXIMITY_WORDS * sizeof(uint64_t), &size);
+	if (!view) return false;
+
+	pb->mapping = view;
+	pb->mappedSize = size;
+	const ProximityBitmapHeader *head = (const ProximityBitmapHeader*) view;
+	if (memcmp(head->magic, s_proximity_magic, sizeof(head->magic)) != 0 ||
+		head->structureType != structureType || head->mc != mc || head->radius != radius) {
+		freeProximityBitmap(pb);
+		return false;
+	}
+	pb->structureType = structureType;
+	pb->mc = mc;
+	pb->radius = radius;
+	pb->bits = (uint64_t*) (view + sizeof(*head));
+	return true;
+}
+
+void freeProximityBitmap(ProximityBitmap *pb) {
+	if (pb->mapping) {
+		unmapFile(pb->mapping, pb->mappedSize);
+	} else {
+		free(pb->bits);
+	}
+	memset(pb, 0, sizeof(*pb));
+}
+
+size_t intersectProximityBits(const uint64_t *const *bits, int n, size_t word0, size_t word1, uint32_t *out, size_t maxOut) {
+	// One cache line of every bitmap at a time, in a form compilers vectorize
+	enum { BLOCK = 8 };
+	size_t found = 0;
+	for (size_t w = word0; w < word1; w += BLOCK) {
+		uint64_t acc[BLOCK], any = 0;
+		int j, k;
+		for (k = 0; k < BLOCK; k++)
+			acc[k] = n > 0 ? bits[0][w + k] : 0;
+		for (j = 1; j < n; j++) {
+			for (k = 0; k < BLOCK; k++)
+				acc[k] &= bits[j][w + k];
+		}
+		for (k = 0; k < BLOCK; k++)
+			any |= acc[k];
+		if (!any) continue;
+
+		for (k = 0; k < BLOCK; k++) {
+			for (uint64_t v = acc[k]; v; v &= v - 1) {
+				if (found < maxOut) out[found] = (uint32_t)(((w + k) << 6) | CTZ64(v));
+				found++;
+			}
+		}
+	}
+	return found;
+}
 
 int getBedrockStronghold(uint64_t seed) {
     static const double PI = 3.1415926535897932384626433;
@@ -61,6 +61,122 @@ int getRavinePos(int mc, uint64_t seed, int x, int z, const Generator *g, Struct
 // Needs fixing
 bool getBedrockRavinePos(uint64_t seed, int x, int z, StructureVariant *ravine);
 
+/* The first two Mersenne Twister calls of the world seed, from which the chunk seeds of
+   ravines and nether complexes are derived. They only depend on the world seed, so they
+   can be computed once per seed. */
+STRUCT(BedrockSeedCalls) {
+	uint64_t seed;
+	uint32_t call1;
+	int call2;
+};
+
+void initBedrockSeedCalls(BedrockSeedCalls *sc, uint64_t seed);
+
+/* Same as getBedrockRavinePos(), for a seed prepared with initBedrockSeedCalls(). */
+bool getBedrockRavinePosSeeded(const BedrockSeedCalls *sc, int x, int z, StructureVariant *ravine);
+
+/* Scans the chunks from (x0, z0) to (x1, z1) inclusive, row by row, and returns the number of ravines.
+   The first `maxOut` ravines are stored in `out`, which may be NULL if `maxOut` is 0. */
+int getBedrockRavinesInArea(const BedrockSeedCalls *sc, int x0, int z0, int x1, int z1, StructureVariant *out, int maxOut);
+
+/* Bastions and fortresses share one placement; returns whether the nether complex starting
+   in the given chunk is a bastion (otherwise it is a fortress). */
+bool isBedrockBastion(const BedrockSeedCalls *sc, int chunkX, int chunkZ);
+
+/* Slime chunks only depend on the chunk coordinates, not on the world seed. */
+static inline bool isBedrockSlimeChunk(int chunkX, int chunkZ) {
+	return mFirst(((uint32_t)chunkX * 0x1f1f1f1fu) ^ (uint32_t)chunkZ) % 10 == 0;
+}
+
+/* One bit per chunk for the slime chunks of a rectangle, row by row with `stride` 64-bit words
+   per row. As slime chunks do not depend on the world seed, one bitmap serves every world, so
+   it can be cached on disk and memory mapped by loadSlimeBitmap(). */
+STRUCT(SlimeBitmap) {
+	int x0, z0;        // chunk of bit 0
+	int w, h;          // size in chunks
+	int stride;        // 64-bit words per row
+	uint64_t *bits;
+	void *mapping;     // start of the file view if mapped, otherwise NULL
+	size_t mappedSize;
+};
+
+/* Allocates an empty bitmap for w*h chunks starting at chunk (x0, z0). */
+bool allocSlimeBitmap(SlimeBitmap *sb, int x0, int z0, int w, int h);
+/* Computes rows [row0, row1) of the bitmap. Row ranges can be filled by separate threads. */
+void fillSlimeBitmap(SlimeBitmap *sb, int row0, int row1);
+/* Writes the bitmap to a cache file. */
+bool saveSlimeBitmap(const SlimeBitmap *sb, const char *path);
+/* Maps a cache file written by saveSlimeBitmap(). Fails if the file is missing, damaged, or
+   covers a different area than (x0, z0, w, h). */
+bool loadSlimeBitmap(SlimeBitmap *sb, const char *path, int x0, int z0, int w, int h);
+void freeSlimeBitmap(SlimeBitmap *sb);
+
+/* An AFK chunk and the number of slime chunks within the AFK radius around it. */
+STRUCT(SlimeCluster) {
+	int x, z;          // chunk coordinates
+	int count;
+};
+
+/* Finds the AFK chunks with the most slime chunks within `radius` chunks (at most 31), counting
+   the chunks whose center is in that circle. Only AFK chunks whose whole circle lies inside the
+   bitmap are considered. The best `maxOut` clusters that are more than `radius` chunks apart are
+   stored in `out`, best first, and their number is returned. */
+int findSlimeClusters(const SlimeBitmap *sb, int radius, SlimeCluster *out, int maxOut);
+
+/* Quad structures: four feature structures (e.g. swamp huts) in the facing corners of a 2x2 block of
+   regions. A region's Mersenne Twister is seeded with the low 32 bits of
+       seed + salt + regX*341873128712 + regZ*132897987541,
+   so whether the block starting at region (regX, regZ) is a quad only depends on that 32-bit base.
+   One scan over the 2^32 bases finds the quads of every seed and block position at once. */
+
+/* Whether the block of regions with base `u` is a quad, with each structure at most `maxOffset`
+   chunks from the inner corner of its region on both axes. Only for feature placement
+   (getBedrockFeaturePos()). */
+bool isBedrockQuadBase(const StructureConfig *sconf, uint32_t u, int maxOffset);
+
+/* Checks the bases from `start` to `start + count - 1` (modulo 2^32) and returns the number of
+   quad bases. The first `maxOut` of them are stored in `out`. */
+int scanBedrockQuadBases(const StructureConfig *sconf, int maxOffset, uint64_t start, uint64_t count, uint32_t *out, int maxOut);
+
+/* The 32-bit world seed that places the quad with base `u` at regions (regX, regZ) to (regX+1, regZ+1). */
+static inline int32_t getBedrockQuadSeed(const StructureConfig *sconf, uint32_t u, int regX, int regZ) {
+	return (int32_t)(u - (uint32_t)sconf->salt - (uint32_t)(regX*UINT64_C(341873128712)) - (uint32_t)(regZ*UINT64_C(132897987541)));
+}
+
+/* Structure proximity bitmaps: one bit per 32-bit seed, set if the seed places a structure of a
+   given type within a radius of (0, 0). Placement only depends on the low 32 bits of the seed, so
+   2^32 bits (512 MB) cover every seed, and a conjunction of "structure within R of the origin"
+   constraints is the AND of their bitmaps. A bitmap of a larger radius is a superset of that of a
+   smaller one. Bit s stands for the 32-bit seed (int32_t)s and is bit (s & 63) of word s >> 6. */
+enum { PROXIMITY_WORDS = 1 << 26 };
+
+STRUCT(ProximityBitmap) {
+	int structureType;
+	int mc;
+	int radius;        // in blocks, a structure counts if (int)sqrt(x*x + z*z) <= radius
+	uint64_t *bits;    // PROXIMITY_WORDS words
+	void *mapping;     // start of the file view if mapped, otherwise NULL
+	size_t mappedSize;
+};
+
+/* Allocates an empty bitmap for the structure type and radius. */
+bool allocProximityBitmap(ProximityBitmap *pb, int structureType, int mc, int radius);
+/* Computes the bits of the seeds [start, start + count), which must both be multiples of 64.
+   Ranges can be filled by separate threads. Feature placements are checked 64 seeds at a time
+   in vectorized lanes, other structures with getBedrockStructurePos(). */
+void fillProximityBitmap(ProximityBitmap *pb, uint32_t start, uint64_t count);
+/* Writes the bitmap to a file that loadProximityBitmap() can map. */
+bool saveProximityBitmap(const ProximityBitmap *pb, const char *path);
+/* Maps a file written by saveProximityBitmap(). Fails if the file is missing, damaged, or is the
+   bitmap of another structure, version or radius. */
+bool loadProximityBitmap(ProximityBitmap *pb, const char *path, int structureType, int mc, int radius);
+void freeProximityBitmap(ProximityBitmap *pb);
+
+/* ANDs the words [word0, word1) of `n` bitmaps, a multiple of 8 words apart, and returns the number
+   of seeds whose bits are set in all of them. The first `maxOut` of these 32-bit seeds are stored
+   in `out`, in increasing order. Word ranges can be intersected by separate threads. */
+size_t intersectProximityBits(const uint64_t *const *bits, int n, size_t word0, size_t word1, uint32_t *out, size_t maxOut);
+
 /* Returns the number of potential strongholds for a given seed */
 int getBedrockStronghold(uint64_t seed);
 
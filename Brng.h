@@ -20,11 +20,12 @@ STRUCT(MersenneTwister) {
 // Initializes a Mersenne Twister for `n` advancements, or fully initializes it if `n` <= 0.
 static inline void mSetSeed(MersenneTwister *mt, uint64_t seed, int n) {
     if (n > 0) n += 397;
-    mt->array[0] = seed;
+    // The state is 32-bit even where uint_fast32_t is wider
+    mt->array[0] = (uint32_t)seed;
     // (size_t)(n - 1) intentionally underflows if n <= 0
     for (size_t i = 1; i <= MIN(sizeof(mt->array)/sizeof(*mt->array) - 1, (size_t)(n - 1)); ++i) {
         seed = mt->array[i - 1] ^ (mt->array[i - 1] >> 30);
-        mt->array[i] = 1812433253 * seed + i;
+        mt->array[i] = (uint32_t)(1812433253 * seed + i);
     }
     mt->currentIndex = sizeof(mt->array)/sizeof(*mt->array);
 }
@@ -109,6 +110,50 @@ static inline bool mNextBool(MersenneTwister *mt) {
     return _mNext(mt) >> 31;
 }
 
+// Returns the first unsigned 32-bit integer of a Mersenne Twister seeded with `seed`.
+// Equivalent to mSetSeed(mt, seed, 1) followed by _mNext(mt), without twisting the whole array.
+static inline uint32_t mFirst(uint64_t seed) {
+    const size_t M = 397;
+    uint32_t a0 = seed, a1 = 0, a = seed;
+    for (size_t i = 1; i <= M; ++i) {
+        seed = a ^ (a >> 30);
+        a = (uint32_t)(1812433253 * seed + i);
+        if (i == 1) a1 = a;
+    }
+    uint32_t val = (a0 & 0x80000000) | (a1 & 0x7fffffff);
+    val = a ^ (val >> 1) ^ (val & 1 ? 2567483615 : 0);
+    val ^= val >> 11;
+    val ^= (val << 7) & 2636928640;
+    val ^= (val << 15) & 4022730752;
+    return val ^ (val >> 18);
+}
+
+// Returns the first two unsigned 32-bit integers of a Mersenne Twister seeded with `seed`, like mFirst().
+// The second output only costs one more step of the seeding recurrence.
+static inline void mFirstTwo(uint64_t seed, uint32_t *out1, uint32_t *out2) {
+    const size_t M = 397;
+    uint32_t a0 = seed, a1 = 0, a2 = 0, a397 = 0, a = seed;
+    for (size_t i = 1; i <= M + 1; ++i) {
+        seed = a ^ (a >> 30);
+        a = (uint32_t)(1812433253 * seed + i);
+        if (i == 1) a1 = a;
+        if (i == 2) a2 = a;
+        if (i == M) a397 = a;
+    }
+    uint32_t v1 = (a0 & 0x80000000) | (a1 & 0x7fffffff);
+    uint32_t v2 = (a1 & 0x80000000) | (a2 & 0x7fffffff);
+    v1 = a397 ^ (v1 >> 1) ^ (v1 & 1 ? 2567483615 : 0);
+    v2 = a    ^ (v2 >> 1) ^ (v2 & 1 ? 2567483615 : 0);
+    v1 ^= v1 >> 11;
+    v1 ^= (v1 << 7) & 2636928640;
+    v1 ^= (v1 << 15) & 4022730752;
+    v2 ^= v2 >> 11;
+    v2 ^= (v2 << 7) & 2636928640;
+    v2 ^= (v2 << 15) & 4022730752;
+    *out1 = v1 ^ (v1 >> 18);
+    *out2 = v2 ^ (v2 >> 18);
+}
+
 // Jumps the Mersenne Twister forward `n` calls.
 static inline void mSkipN(MersenneTwister *mt, uint64_t n) {
     uint64_t mIndex = mt->currentIndex + n; // Separate variable because mt->currentIndex is only 16 bits, while n can be up to 64
@@ -10,18 +10,30 @@
 #endif
 #include <GLFW/glfw3.h>
 #include <Windows.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include <filesystem>
 #include <vector>
 #include <fstream>
 #include <atomic>
 #include <mutex>
 #include <queue>
+#include <deque>
+#include <list>
+#include <memory>
+#include <tuple>
+#include <type_traits>
 #include <condition_variable>
 #include <random>
 #include <set>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
+#include <climits>
 #include "Brng.h"
 
 // Global variables
@@ -78,6 +90,7 @@ struct AppSettings {
     int batchSize = 200000;
     int generatorPoolSize = 64;
     int threadCount = 1;
+    int mapCacheMB = 256;  // seed map generators and tiles, see MapCache
     
     // UI Settings
     float guiScale = 1.0f;
@@ -91,6 +104,7 @@ struct AppSettings {
             fprintf(f, "batchSize=%d\n", batchSize);
             fprintf(f, "generatorPoolSize=%d\n", generatorPoolSize);
             fprintf(f, "threadCount=%d\n", threadCount);
+            fprintf(f, "mapCacheMB=%d\n", mapCacheMB);
             
             fprintf(f, "\n[UI]\n");
             fprintf(f, "guiScale=%f\n", guiScale);
@@ -146,6 +160,7 @@ struct AppSettings {
                 if (strcmp(key, "batchSize") == 0) batchSize = atoi(value);
                 else if (strcmp(key, "generatorPoolSize") == 0) generatorPoolSize = atoi(value);
                 else if (strcmp(key, "threadCount") == 0) threadCount = atoi(value);
+                else if (strcmp(key, "mapCacheMB") == 0) mapCacheMB = std::max(16, atoi(value));
             }
             else if (strcmp(section, "UI") == 0) {
                 if (strcmp(key, "guiScale") == 0) guiScale = (float)atof(value);
@@ -213,6 +228,8 @@ std::string ShowOpenFileDialog() {
 
 #include "cubiomes/generator.h"
 #include "cubiomes/finders.h"
+#include "cubiomes/util.h"
+#include "cubiomes/quadbase.h"
 #include "Bfinders.h"
 
 // Forward declare ApplyCustomColors
@@ -461,7 +478,650 @@ void ShowThemeSelector() {
 struct FoundStructure {
     uint64_t seed;
     Pos pos;
-    bool isZombieVillage;
+    bool isZombieVillage;  // never set, the Bedrock village variant roll is not known
+};
+
+// Append-only file of fixed-size records, so that search results survive a
+// crash and need not all be held in memory. Records are appended in batches
+// and flushed to the file at least once a second. Reading maps the file, so
+// only the pages that are looked at are loaded. A torn record at the end of
+// the file, left by a crash in the middle of a write, is dropped on open.
+// Records that cannot be written stay in memory until a later flush writes
+// them, and healthy() is false meanwhile.
+template <typename T>
+class ResultJournal {
+    static_assert(std::is_trivially_copyable<T>::value, "journal records are written as raw bytes");
+
+public:
+    ResultJournal() = default;
+    ~ResultJournal() { close(); }
+
+    // Opens a journal, keeping the records of an existing file of the same
+    // record size. Returns the number of records kept.
+    size_t open(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        closeLocked();
+        filePath = path;
+        file = fopen(path.c_str(), "r+b");
+
+        Header h;
+        if (file && fread(&h, sizeof(h), 1, file) == 1 &&
+            memcmp(h.magic, JOURNAL_MAGIC, sizeof(h.magic)) == 0 && h.recordSize == sizeof(T)) {
+            seek64(file, 0, SEEK_END);
+            int64_t bytes = tell64(file);
+            flushed = bytes > (int64_t)sizeof(Header) ? (size_t)(bytes - sizeof(Header)) / sizeof(T) : 0;
+            // the next write overwrites a torn record, if any
+            seek64(file, (int64_t)(sizeof(Header) + flushed * sizeof(T)), SEEK_SET);
+            return flushed;
+        }
+
+        if (file) fclose(file);
+        file = nullptr;
+        startLocked();
+        return 0;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closeLocked();
+    }
+
+    // Drops all records
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (filePath.empty()) return;
+        unmapLocked();
+        if (file) fclose(file);
+        file = nullptr;
+        pending.clear();
+        startLocked();
+    }
+
+    void append(const T& record) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(record);
+        if (pending.size() >= BATCH_RECORDS) flushLocked();
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return flushed + pending.size();
+    }
+
+    // Copies record i, from the mapped file or from the unwritten batch
+    bool get(size_t i, T* out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (i >= flushed) {
+            if (i - flushed >= pending.size()) return false;
+            *out = pending[i - flushed];
+            return true;
+        }
+        if (i >= mappedCount) mapLocked();
+        if (i >= mappedCount) return false;
+        memcpy(out, (const char*)mapping + sizeof(Header) + i * sizeof(T), sizeof(T));
+        return true;
+    }
+
+    // Writes the batch out once it is older than the flush interval
+    void flushIfDue() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!pending.empty() && std::chrono::steady_clock::now() - lastFlush >= FLUSH_INTERVAL)
+            flushLocked();
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushLocked();
+    }
+
+    // Whether the journal has a file and its last write succeeded
+    bool healthy() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return file && !writeFailed;
+    }
+
+private:
+    static constexpr const char* JOURNAL_MAGIC = "CBRJRN01";
+    static const size_t BATCH_RECORDS = 1024;
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{1000};
+
+    struct Header {
+        char magic[8];
+        uint32_t recordSize;
+        uint32_t reserved[13];  // pads the header to 64 bytes
+    };
+
+    // Journals can outgrow the 2 GB reach of fseek()
+    static int seek64(FILE* f, int64_t offset, int whence) {
+#ifdef _WIN32
+        return _fseeki64(f, offset, whence);
+#else
+        return fseeko(f, (off_t)offset, whence);
+#endif
+    }
+
+    static int64_t tell64(FILE* f) {
+#ifdef _WIN32
+        return _ftelli64(f);
+#else
+        return ftello(f);
+#endif
+    }
+
+    // Creates an empty journal at filePath
+    void startLocked() {
+        flushed = 0;
+        writeFailed = false;
+        lastFlush = std::chrono::steady_clock::now();
+        file = fopen(filePath.c_str(), "w+b");
+        if (!file) return;
+        Header h = {};
+        memcpy(h.magic, JOURNAL_MAGIC, sizeof(h.magic));
+        h.recordSize = sizeof(T);
+        if (fwrite(&h, sizeof(h), 1, file) != 1 || fflush(file) != 0) {
+            fclose(file);
+            file = nullptr;
+        }
+    }
+
+    void flushLocked() {
+        lastFlush = std::chrono::steady_clock::now();
+        if (pending.empty()) return;
+        // a journal that could not be created is tried again, it has no records yet
+        if (!file && !filePath.empty()) startLocked();
+        if (!file) {
+            writeFailed = true;
+            return;
+        }
+        if (fwrite(pending.data(), sizeof(T), pending.size(), file) == pending.size() && fflush(file) == 0) {
+            flushed += pending.size();
+            pending.clear();
+            writeFailed = false;
+            return;
+        }
+        // Part of the batch may have been written. The batch is kept and the
+        // file position goes back to the end of the flushed records, so the
+        // next flush writes it again in the right place.
+        clearerr(file);
+        seek64(file, (int64_t)(sizeof(Header) + flushed * sizeof(T)), SEEK_SET);
+        writeFailed = true;
+    }
+
+    void closeLocked() {
+        flushLocked();
+        unmapLocked();
+        if (file) fclose(file);
+        file = nullptr;
+        pending.clear();
+        flushed = 0;
+        writeFailed = false;
+    }
+
+    // Maps everything flushed so far, replacing an older, shorter mapping
+    void mapLocked() {
+        unmapLocked();
+        if (flushed == 0) return;
+        size_t bytes = sizeof(Header) + flushed * sizeof(T);
+#ifdef _WIN32
+        HANDLE fh = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (fh == INVALID_HANDLE_VALUE) return;
+        HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+        CloseHandle(fh);
+        if (!mh) return;
+        mapping = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, bytes);
+        CloseHandle(mh);
+        if (!mapping) return;
+#else
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        void* p = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return;
+        mapping = p;
+#endif
+        mappedBytes = bytes;
+        mappedCount = flushed;
+    }
+
+    void unmapLocked() {
+        if (!mapping) return;
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, mappedBytes);
+#endif
+        mapping = nullptr;
+        mappedBytes = 0;
+        mappedCount = 0;
+    }
+
+    std::mutex mutex;
+    std::string filePath;
+    FILE* file = nullptr;
+    std::vector<T> pending;  // appended but not yet written
+    size_t flushed = 0;      // records in the file
+    bool writeFailed = false;
+    std::chrono::steady_clock::time_point lastFlush;
+    void* mapping = nullptr;
+    size_t mappedBytes = 0;
+    size_t mappedCount = 0;
+};
+
+// Memory-budgeted LRU cache for the seed map, holding both seeded generators
+// and rendered tiles, so going back to a recently viewed seed needs neither
+// applySeed() nor genBiomes(). Entries are handed out as shared pointers, so
+// evicting one never pulls it from under a thread that is still using it.
+class MapCache {
+public:
+    struct Key {
+        int64_t seed;
+        int mc;
+        int dim;
+        int scale;  // blocks per biome cell, 0 for the seeded generator
+        int x, z;   // in tiles of this scale
+
+        bool operator<(const Key& o) const {
+            return std::tie(seed, mc, dim, scale, x, z) < std::tie(o.seed, o.mc, o.dim, o.scale, o.x, o.z);
+        }
+    };
+    typedef std::shared_ptr<const std::vector<unsigned char>> Pixels;
+
+    struct Stats {
+        uint64_t hits, misses;
+        size_t bytes, budget, entries;
+    };
+
+    explicit MapCache(size_t budget) : budget(budget) {}
+
+    // Seeded generator of a seed, version and dimension, created on a miss
+    std::shared_ptr<const Generator> generator(int64_t seed, int mc, int dim) {
+        Key key = { seed, mc, dim, 0, 0, 0 };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (Entry* e = lookup(key)) {
+                hits++;
+                return e->gen;
+            }
+            misses++;
+        }
+
+        // Seeded outside the lock; the noise octaves point into the object,
+        // so it is never copied once seeded
+        auto g = std::make_shared<Generator>();
+        setupGenerator(g.get(), mc, 0);
+        applySeed(g.get(), dim, seed);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (Entry* e = lookup(key))  // seeded by another thread meanwhile
+            return e->gen;
+        insert(key, sizeof(Generator)).gen = g;
+        return g;
+    }
+
+    // Rendered tile, or null if it is not cached
+    Pixels tile(const Key& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry* e = lookup(key);
+        if (!e) return nullptr;
+        hits++;
+        return e->pixels;
+    }
+
+    // Stores a tile that had to be generated
+    void putTile(const Key& key, Pixels pixels) {
+        std::lock_guard<std::mutex> lock(mutex);
+        misses++;
+        if (lookup(key)) return;
+        insert(key, pixels->size()).pixels = pixels;
+    }
+
+    void setBudget(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        budget = bytes;
+        evict();
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return { hits, misses, used, budget, entries.size() };
+    }
+
+private:
+    // Bookkeeping per entry besides its payload: map node, list node, control block
+    static const size_t entryOverhead = 160;
+
+    struct Entry {
+        std::shared_ptr<const Generator> gen;
+        Pixels pixels;
+        size_t bytes;
+        std::list<Key>::iterator lru;
+    };
+
+    // Finds an entry and marks it as the most recently used
+    Entry* lookup(const Key& key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) return nullptr;
+        order.splice(order.begin(), order, it->second.lru);
+        return &it->second;
+    }
+
+    Entry& insert(const Key& key, size_t bytes) {
+        order.push_front(key);
+        Entry& e = entries[key];
+        e.bytes = bytes + entryOverhead;
+        e.lru = order.begin();
+        used += e.bytes;
+        evict();
+        return e;
+    }
+
+    // Drops the least recently used entries until the budget is met. The
+    // newest entry always stays, even if it alone is over the budget.
+    void evict() {
+        while (used > budget && order.size() > 1) {
+            auto it = entries.find(order.back());
+            used -= it->second.bytes;
+            entries.erase(it);
+            order.pop_back();
+        }
+    }
+
+    std::mutex mutex;
+    std::map<Key, Entry> entries;
+    std::list<Key> order;  // most recently used first
+    size_t used = 0;
+    size_t budget;
+    uint64_t hits = 0, misses = 0;
+};
+
+// Biome map of a single seed. The map is drawn from square tiles that
+// background threads generate with genBiomes() and convert with
+// biomesToImage(), so the UI thread only uploads finished images as textures.
+// Every view is first covered by 1:256 tiles and then refined scale by scale
+// down to the one matching the zoom. Tiles that scroll out of view before a
+// thread picks them up are dropped from the queue. Generators and tiles are
+// kept in a MapCache, so revisited tiles skip the workers entirely.
+class SeedMapViewer {
+public:
+    struct Marker {
+        std::string label;
+        Pos pos;
+    };
+
+    SeedMapViewer(int threadCount, size_t cacheBytes) : cache(cacheBytes) {
+        initBiomeColors(biomeColors);
+        for (int i = 0; i < threadCount; i++)
+            workers.emplace_back(&SeedMapViewer::tileWorker, this);
+    }
+
+    ~SeedMapViewer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        cv.notify_all();
+        for (auto& t : workers) t.join();
+        // The textures are released together with the GL context
+    }
+
+    bool hasSeed() const { return seedSet; }
+    int64_t currentSeed() const { return seed; }
+
+    MapCache& tileCache() { return cache; }
+
+    // Shows the overworld of a seed in version 'newMc', centered on 'center'.
+    // Textures of the previous seed stay until evicted, so switching back is instant.
+    void show(int64_t newSeed, int newMc, Pos center, std::vector<Marker> newMarkers) {
+        if (!seedSet || newSeed != seed || newMc != mc) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.clear();
+        }
+        seed = newSeed;
+        mc = newMc;
+        seedSet = true;
+        viewX = center.x;
+        viewZ = center.z;
+        markers = std::move(newMarkers);
+    }
+
+    // Draws the map into a canvas of the given size at the cursor. Dragging
+    // pans and the mouse wheel zooms around the cursor.
+    void render(ImVec2 size) {
+        uploadFinished();
+
+        ImGuiIO& io = ImGui::GetIO();
+        ImVec2 p0 = ImGui::GetCursorScreenPos();
+        ImVec2 p1(p0.x + size.x, p0.y + size.y);
+        ImVec2 c(p0.x + size.x * 0.5f, p0.y + size.y * 0.5f);
+        ImGui::InvisibleButton("##seedmap", size);
+        bool hovered = ImGui::IsItemHovered();
+
+        if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left, 0.0f)) {
+            viewX -= io.MouseDelta.x * blocksPerPixel;
+            viewZ -= io.MouseDelta.y * blocksPerPixel;
+        }
+        if (hovered && io.MouseWheel != 0.0f) {
+            // keep the block under the cursor in place
+            double mx = viewX + (io.MousePos.x - c.x) * blocksPerPixel;
+            double mz = viewZ + (io.MousePos.y - c.y) * blocksPerPixel;
+            blocksPerPixel *= pow(1.25, -io.MouseWheel);
+            blocksPerPixel = std::min(std::max(blocksPerPixel, 0.25), 1024.0);
+            viewX = mx - (io.MousePos.x - c.x) * blocksPerPixel;
+            viewZ = mz - (io.MousePos.y - c.y) * blocksPerPixel;
+        }
+
+        auto toScreen = [&](double x, double z) {
+            return ImVec2(c.x + (float)((x - viewX) / blocksPerPixel),
+                          c.y + (float)((z - viewZ) / blocksPerPixel));
+        };
+
+        std::vector<TileKey> wanted;
+        if (seedSet) {
+            wanted = visibleTiles(size);
+            uploadCached(wanted);
+            requestTiles(wanted);
+        }
+
+        ImDrawList* dl = ImGui::GetWindowDrawList();
+        dl->PushClipRect(p0, p1, true);
+        dl->AddRectFilled(p0, p1, IM_COL32(24, 24, 24, 255));
+
+        // coarse tiles come first, so finer ones are drawn over them
+        for (const TileKey& k : wanted) {
+            auto it = textures.find(k);
+            if (it == textures.end()) continue;
+            it->second.lastUsed = frame;
+            double span = (double)TILE_CELLS * k.scale;
+            dl->AddImage((ImTextureID)(intptr_t)it->second.texture,
+                         toScreen(k.x * span, k.z * span),
+                         toScreen((k.x + 1) * span, (k.z + 1) * span));
+        }
+
+        for (const Marker& m : markers) {
+            ImVec2 s = toScreen(m.pos.x, m.pos.z);
+            dl->AddCircleFilled(s, 5.0f, IM_COL32(255, 255, 255, 255));
+            dl->AddCircle(s, 5.0f, IM_COL32(0, 0, 0, 255), 0, 2.0f);
+            dl->AddText(ImVec2(s.x + 8, s.y - 8), IM_COL32(255, 255, 255, 255), m.label.c_str());
+        }
+        dl->PopClipRect();
+
+        if (hovered && seedSet) {
+            ImGui::SetTooltip("X: %d, Z: %d",
+                              (int)floor(viewX + (io.MousePos.x - c.x) * blocksPerPixel),
+                              (int)floor(viewZ + (io.MousePos.y - c.y) * blocksPerPixel));
+        }
+
+        evictTextures();
+        frame++;
+    }
+
+    double zoom() const { return blocksPerPixel; }
+
+private:
+    static const int TILE_CELLS = 128;    // biome cells along each side of a tile
+    static const int MAX_TEXTURES = 1024; // tiles kept on the GPU
+    static const int MAX_CACHED_UPLOADS = 32; // cached tiles uploaded per frame
+
+    typedef MapCache::Key TileKey;  // scale is 256, 64, 16 or 4
+
+    struct TileImage {
+        TileKey key;
+        MapCache::Pixels rgb;
+    };
+
+    struct TileTexture {
+        GLuint texture;
+        uint64_t lastUsed;  // frame
+    };
+
+    // Tiles covering the view, from the 1:256 scale down to the one whose
+    // cells are at least a pixel wide, each scale nearest to the center first
+    std::vector<TileKey> visibleTiles(ImVec2 size) {
+        int target = 4;
+        while (target < 256 && target * 4 <= blocksPerPixel) target *= 4;
+
+        double hx = size.x * 0.5 * blocksPerPixel, hz = size.y * 0.5 * blocksPerPixel;
+        std::vector<TileKey> out;
+        for (int scale = 256; scale >= target; scale /= 4) {
+            double span = (double)TILE_CELLS * scale;
+            int tx0 = (int)floor((viewX - hx) / span), tx1 = (int)floor((viewX + hx) / span);
+            int tz0 = (int)floor((viewZ - hz) / span), tz1 = (int)floor((viewZ + hz) / span);
+            size_t first = out.size();
+            for (int tz = tz0; tz <= tz1; tz++)
+                for (int tx = tx0; tx <= tx1; tx++)
+                    out.push_back({ seed, mc, DIM_OVERWORLD, scale, tx, tz });
+
+            double cx = viewX / span - 0.5, cz = viewZ / span - 0.5;
+            std::sort(out.begin() + first, out.end(), [cx, cz](const TileKey& a, const TileKey& b) {
+                return (a.x - cx)*(a.x - cx) + (a.z - cz)*(a.z - cz) <
+                       (b.x - cx)*(b.x - cx) + (b.z - cz)*(b.z - cz);
+            });
+        }
+        return out;
+    }
+
+    // Uploads wanted tiles straight from the cache, a few per frame
+    void uploadCached(const std::vector<TileKey>& wanted) {
+        int uploads = 0;
+        for (const TileKey& k : wanted) {
+            if (uploads >= MAX_CACHED_UPLOADS) break;
+            if (textures.count(k)) continue;
+            if (MapCache::Pixels rgb = cache.tile(k)) {
+                upload(k, *rgb);
+                uploads++;
+            }
+        }
+    }
+
+    // Replaces the queue with the wanted tiles that are not on the GPU or
+    // being generated yet. Queued tiles that are no longer wanted are dropped.
+    void requestTiles(const std::vector<TileKey>& wanted) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.clear();
+        for (const TileKey& k : wanted) {
+            if (textures.count(k) || inProgress.count(k)) continue;
+            pending.push_back(k);
+        }
+        if (!pending.empty()) cv.notify_all();
+    }
+
+    void uploadFinished() {
+        std::vector<TileImage> images;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            images.swap(finished);
+        }
+        for (const TileImage& img : images) {
+            if (!seedSet || img.key.seed != seed || img.key.mc != mc || textures.count(img.key)) continue;
+            upload(img.key, *img.rgb);
+        }
+    }
+
+    void upload(const TileKey& key, const std::vector<unsigned char>& rgb) {
+        GLuint tex;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, TILE_CELLS, TILE_CELLS, 0,
+                     GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+        textures[key] = { tex, frame };
+    }
+
+    // Deletes the least recently drawn textures beyond MAX_TEXTURES
+    void evictTextures() {
+        if (textures.size() <= MAX_TEXTURES) return;
+        std::vector<std::pair<uint64_t, TileKey>> byAge;
+        for (const auto& t : textures)
+            byAge.push_back({ t.second.lastUsed, t.first });
+        std::sort(byAge.begin(), byAge.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < byAge.size() - MAX_TEXTURES && byAge[i].first != frame; i++) {
+            auto it = textures.find(byAge[i].second);
+            glDeleteTextures(1, &it->second.texture);
+            textures.erase(it);
+        }
+    }
+
+    void tileWorker() {
+        std::vector<int> ids;
+
+        for (;;) {
+            TileKey k;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return quit || !pending.empty(); });
+                if (quit) return;
+                k = pending.front();
+                pending.pop_front();
+                inProgress.insert(k);
+            }
+
+            TileImage img;
+            img.key = k;
+            img.rgb = cache.tile(k);
+            bool ok = img.rgb != nullptr;
+            if (!ok) {
+                std::shared_ptr<const Generator> g = cache.generator(k.seed, k.mc, k.dim);
+                Range r = { k.scale, k.x * TILE_CELLS, k.z * TILE_CELLS, TILE_CELLS, TILE_CELLS, 63 / k.scale, 1 };
+                ids.resize(getMinCacheSize(g.get(), r.scale, r.sx, r.sy, r.sz));
+                ok = genBiomes(g.get(), ids.data(), r) == 0;
+                if (ok) {
+                    auto rgb = std::make_shared<std::vector<unsigned char>>(TILE_CELLS * TILE_CELLS * 3);
+                    biomesToImage(rgb->data(), biomeColors, ids.data(), TILE_CELLS, TILE_CELLS, 1, 1);
+                    cache.putTile(k, rgb);
+                    img.rgb = rgb;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            inProgress.erase(k);
+            if (ok) finished.push_back(std::move(img));
+        }
+    }
+
+    unsigned char biomeColors[256][3];
+    MapCache cache;
+
+    // Shared with the workers, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<TileKey> pending;
+    std::set<TileKey> inProgress;
+    std::vector<TileImage> finished;
+    bool quit = false;
+    std::vector<std::thread> workers;
+
+    // UI thread only
+    std::map<TileKey, TileTexture> textures;
+    std::vector<Marker> markers;
+    int64_t seed = 0;
+    int mc = MC_NEWEST;
+    bool seedSet = false;
+    double viewX = 0, viewZ = 0;     // block at the center of the view
+    double blocksPerPixel = 4.0;
+    uint64_t frame = 0;
 };
 
 class StructureFinder {
@@ -477,18 +1137,33 @@ private:
 
     std::atomic<bool> shouldStop{false};
     std::vector<std::thread> searchThreads;
-    std::vector<std::string> structureNames;  // Change to std::vector<std::string>
-    std::vector<Pos> positions;
     std::string currentStatus;
     bool isSearching = false;
+    bool searchComplete = false;  // the last search ran out of work instead of being stopped
     std::atomic<int64_t> seedsChecked{0};
     std::atomic<int64_t> currentSeed{0};
     std::mutex structuresMutex;
-    std::vector<int64_t> foundSeeds;
     int selectedStructure = Village;
     int maxSearchRadius = 256;  // Changed from 2000 to 256
     int minSearchRadius = 0;    // Add min search radius
 
+    // Measure the search radius and the overworld constraint from world spawn
+    // instead of (0, 0). The spawn is the Java Edition spawn from cubiomes,
+    // which is close to, but not always the same as, the Bedrock spawn.
+    bool spawnRelative = false;
+    // Farthest the exact spawn can be from estimateSpawn(), see refineSpawn().
+    // 1.18+ moves it at most 95 blocks along each axis, up to 1.17 it spirals
+    // out by up to 16 chunks (271 blocks along each axis).
+    static int spawnRefineMargin(int mc) {
+        return mc >= MC_1_18 ? 135 : 384;
+    }
+    // Farthest the spawn can be from the origin: in 1.18+ the estimate searches
+    // up to 2048 + 512 blocks out and is then moved to the chunk center, up to
+    // 1.17 it is a biome within 256 blocks along each axis
+    static int spawnMaxReach(int mc) {
+        return (mc >= MC_1_18 ? 2560 + 12 : 363) + spawnRefineMargin(mc);
+    }
+
     // Add these to track search performance
     std::chrono::steady_clock::time_point searchStartTime;
     double lastCalculatedSeedsPerSecond{0.0};
@@ -501,6 +1176,10 @@ private:
     // Add a new member for seed range selection
     bool useBedrockRange = false;  // Default to 64-bit range
 
+    // Game version the search generates for. Up to 1.17 the overworld biomes
+    // come from the layer stack, which rejects areas at its coarse layers.
+    int mcVersion = MC_NEWEST;
+
     // Optimize batch size for thorough checking
     int OPTIMAL_BATCH_SIZE = 200000;  // Increased batch size
     const int STATUS_UPDATE_INTERVAL = 5000;  // Less frequent updates
@@ -523,103 +1202,783 @@ private:
     };
     
     bool multiStructureMode = false;
+    enum { MAX_ATTACHED = 5 };
     std::vector<AttachedStructure> attachedStructures;
     int baseStructureType = Village;  // The main structure to search around
 
-public:
-    StructureFinder() : 
-        gen(rd())
-    {
-        // setupGenerator(&g, MC_NEWEST, 0);  // Initialize generator in constructor
-    }
-
-    ~StructureFinder() {
-        stopSearch();
-    }
+    // Ravine search, run by the same search threads as the structure search
+    struct RavineQuery {
+        int radius = 256;       // in blocks, around the origin
+        int minCount = 1;       // ravines required within the radius
+        bool giantOnly = false; // only count giant ravines
+    };
+    RavineQuery ravineQuery;
 
-    const char* struct2str(int structureType) {
-        switch (structureType) {
-            case Village:           return "Village";
-            case Desert_Pyramid:    return "Desert Pyramid";
-            case Jungle_Pyramid:    return "Jungle Pyramid";
-            case Swamp_Hut:        return "Swamp Hut";
-            case Igloo:            return "Igloo";
-            case Monument:         return "Monument";
-            case Mansion:          return "Mansion";
-            case Outpost:          return "Outpost";
-            case Ancient_City:     return "Ancient City";
-            case Ruined_Portal:    return "Ruined Portal";
-            case Shipwreck:        return "Shipwreck";
-            default:               return "Unknown";
-        }
-    }
+    // End city search, using only the End generator
+    struct EndCityQuery {
+        int radius = 2048;      // in blocks, cities start at 1008 blocks
+        int minCount = 1;       // cities required within the radius
+        bool shipOnly = false;  // only count cities with an end ship
+    };
+    EndCityQuery endCityQuery;
+
+    // Biome search: nearest occurrence and coverage of a biome around the
+    // origin, or around world spawn
+    struct BiomeQuery {
+        int biomeId = mushroom_fields;
+        int radius = 1024;        // in blocks
+        bool fromSpawn = false;   // center the search on world spawn
+        float minCoverage = 0.0f; // required fraction of the search circle
+        bool areaEnabled = false; // require a contiguous square of the biome
+        int areaSize = 256;       // side of that square, in blocks
+    };
+    BiomeQuery biomeQuery;
+
+    // Quad swamp hut search over all 2^32 region bases, see scanBedrockQuadBases().
+    // Outposts use large structure placement with 80 chunk regions on Bedrock,
+    // so they cannot form quads.
+    struct QuadQuery {
+        int maxOffset = 3;   // chunks between each hut and its region's inner corner
+        int radius = 2048;   // AFK spot within this many blocks of the origin
+    };
+    QuadQuery quadQuery;
+    std::atomic<int> quadThreadsLeft{0};
+
+    // Slime chunk cluster finder. Slime chunks do not depend on the seed, so
+    // the bitmap of an area is computed once and cached on disk.
+    struct SlimeQuery {
+        int centerX = 0, centerZ = 0;  // in chunks
+        int halfSize = 2048;           // in chunks, the area is twice this wide
+        int afkRadius = 8;             // in chunks
+        int resultCount = 10;
+    };
+    SlimeQuery slimeQuery;
+
+    // Biome map of a result, see renderMapTab()
+    SeedMapViewer seedMap{2, (size_t)appSettings.mapCacheMB << 20};
+    int64_t mapSeedInput = 0;
+    bool selectMapTab = false;
+    std::thread slimeThread;
+    std::atomic<bool> slimeBusy{false};
+    std::string slimeStatus;                 // guarded by structuresMutex
+    std::vector<SlimeCluster> slimeClusters; // guarded by structuresMutex
+
+    // Cross-dimension constraints of the structure search: a structure within
+    // some distance of the origin of its own dimension
+    enum { DIMQ_OVERWORLD, DIMQ_NETHER, DIMQ_END, DIMQ_NUM };
+    struct DimensionQuery {
+        bool enabled;
+        int structureType;
+        int maxDistance;  // in blocks of that dimension
+    };
+    DimensionQuery dimensionQueries[DIMQ_NUM] = {
+        { false, Village,  256 },
+        { false, Bastion,  256 },
+        { false, End_City, 1500 },
+    };
 
-    int getStructureTypeFromIndex(int index) {
-        switch(index) {
-            case 0: return Village;
-            case 1: return Desert_Pyramid;
-            case 2: return Jungle_Pyramid;
-            case 3: return Swamp_Hut;
-            case 4: return Igloo;
-            case 5: return Monument;
-            case 6: return Mansion;
-            case 7: return Outpost;
-            case 8: return Ancient_City;
-            case 9: return Ruined_Portal;
-            case 10: return Shipwreck;
-            default: return Village;
+    // Query planner stages: one per dimension query plus the structure search
+    // itself. Every stage is timed, so that the stage rejecting seeds most
+    // cheaply runs first and the others only seed their noise for survivors.
+    enum { STAGE_BASE = DIMQ_NUM, STAGE_NUM };
+    struct StageStats {
+        std::atomic<uint64_t> nanos{0};
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> passes{0};
+    };
+    StageStats stageStats[STAGE_NUM];
+
+    // What the search threads are looking for
+    enum SearchKind { SEARCH_STRUCTURES, SEARCH_RAVINES, SEARCH_BIOMES, SEARCH_END_CITIES, SEARCH_QUADS };
+    SearchKind searchKind = SEARCH_STRUCTURES;
+
+    // One search result as plain fields. The text shown for a result is
+    // derived from them when drawn or saved, never parsed back out of a
+    // string, and the record has a fixed size.
+    // Room for every extra a result can have: world spawn, the required
+    // attached structures and one structure per cross-dimension constraint
+    enum { RESULT_MAX_EXTRAS = 1 + MAX_ATTACHED + DIMQ_NUM };
+    enum { EXTRA_SPAWN = -1 };   // ResultExtra::type of the world spawn
+    enum { EXTRA_ATTACHED = -1 }; // ResultExtra::dim of attached structures
+    enum {
+        RESULT_GIANT = 1,  // giant ravines only
+        RESULT_SHIP = 2,   // End cities with a ship only
+        RESULT_AREA = 4,   // biome search with a contiguous square
+    };
+    struct ResultExtra {
+        int32_t type;  // structure type, or EXTRA_SPAWN
+        int32_t dim;   // DIMQ_* of a cross-dimension constraint, or EXTRA_ATTACHED
+        Pos pos;
+    };
+    struct SearchResult {
+        int64_t seed;
+        int32_t kind;      // SearchKind
+        int32_t type;      // structure type, or biome id for biome searches
+        int32_t count;     // matches in range, quad spawning spaces or biome square side
+        uint32_t flags;    // RESULT_* flags
+        float value;       // biome coverage
+        int32_t distance;  // of pos from the origin, or from world spawn
+        Pos pos;
+        int32_t extraCount;
+        ResultExtra extras[RESULT_MAX_EXTRAS];
+        int32_t mc;        // game version of the search, MC_UNDEF in older journals
+    };
+    static_assert(sizeof(SearchResult) == 192, "SearchResult is the journal record layout");
+
+    // Results are streamed to a journal file instead of being kept in memory.
+    // It is cleared when a search starts and reopened on startup, so the
+    // results of a crashed session are still there.
+    ResultJournal<SearchResult> results;
+    static constexpr const char* resultJournalPath = "results.journal";
+    uint64_t resultsVersion = 0;  // bumped when the journal is rewritten, guarded by structuresMutex
+
+    // Every seed that passed the structure query, kept across sessions along
+    // with that query, so a tightened query only has to re-check these seeds
+    // instead of searching again, see startSearch(true). In ranking mode it
+    // also has the seeds that did not make the ranking.
+    struct QueryEnvelope {
+        int32_t multi;
+        int32_t structureType;  // base structure in multi mode
+        int32_t minRadius, maxRadius;
+        int32_t spawnRelative;
+        int32_t attachedCount;  // required attached structures
+        struct { int32_t type, minDistance, maxDistance; } attached[MAX_ATTACHED];
+        struct { int32_t enabled, type, maxDistance; } dims[DIMQ_NUM];
+        int32_t surroundingEnabled, surroundingBiome, surroundingRadius;
+        float surroundingCoverage;
+        int32_t bedrockRange;
+        int32_t mc;             // game version of the search
+        int32_t rankMetric;     // -1 unless the search was ranked
+        int32_t rankK;
+        int64_t seedsChecked;   // by the search that produced the candidates
+    };
+    ResultJournal<int64_t> candidates;
+    ResultJournal<QueryEnvelope> candidateQuery;  // holds a single record
+    static constexpr const char* candidatePath = "candidates.journal";
+    static constexpr const char* candidateQueryPath = "candidates.query";
+    QueryEnvelope candidateEnvelope = {};
+    bool hasCandidates = false;
+    bool refining = false;  // the running search re-checks the candidates
+    std::atomic<int> refineThreadsLeft{0};
+
+    // Structure proximity bitmaps over the 32-bit seed space, see ProximityBitmap.
+    // They are built in the Bitmaps tab, and a 32-bit structure search ANDs the
+    // bitmaps of its "structure within R of the origin" constraints to only
+    // check the seeds whose placements can match.
+    static constexpr int proximityRadii[] = { 128, 256, 512, 1024, 2048, 4096 };
+    static constexpr const char* bitmapDir = "bitmaps";
+    bool useBitmaps = false;
+    std::set<std::pair<int, int>> builtBitmaps;  // (structure type, radius) on disk
+    int bitmapStructureIndex = 0;
+    int bitmapRadiusIndex = 1;
+    std::thread bitmapThread;
+    std::atomic<bool> bitmapBusy{false};
+    std::atomic<bool> bitmapCancel{false};
+    std::atomic<uint64_t> bitmapProgress{0};  // seeds filled by the running build
+    std::string bitmapStatus;                 // guarded by structuresMutex
+    std::vector<ProximityBitmap> searchBitmaps;  // mapped for the running search
+    std::atomic<uint64_t> bitmapNextWord{0};
+    std::atomic<int> bitmapThreadsLeft{0};
+
+    // Ranking mode: instead of stopping at the first hit or keeping every hit,
+    // the structure search keeps the K best scoring seeds. Each thread ranks
+    // its hits in a bounded heap and merges it into the shared one every
+    // rankMergeMillis. Once K seeds are ranked, the K-th best score bounds the
+    // placement checks of every thread, see rankDistanceLimit().
+    enum RankMetric { RANK_DISTANCE, RANK_CLUSTER, RANK_CONSTRAINTS };
+    struct RankQuery {
+        bool enabled = false;
+        int metric = RANK_DISTANCE;
+        int k = 100;  // seeds to keep
+    };
+    RankQuery rankQuery;
+    struct RankedResult {
+        double score;  // higher is better, see rankScore()
+        SearchResult result;
+    };
+    static constexpr double rankConstraintWeight = 1e7;  // more than any distance
+    static constexpr int rankMaxK = 10000;
+    static constexpr int rankMergeMillis = 250;
+    static constexpr int rankPublishMillis = 500;
+    bool ranking = false;  // rankQuery applies to the running search
+    size_t rankK = 0;
+    int rankMetric = RANK_DISTANCE;  // rankQuery.metric of the running search
+    std::vector<RankedResult> ranked;  // min-heap of the best results, guarded by structuresMutex
+    std::unordered_set<int64_t> rankedSeeds;  // seeds in 'ranked', guarded by structuresMutex
+    bool rankChanged = false;          // guarded by structuresMutex
+    std::atomic<double> rankThreshold{-INFINITY};  // K-th best score once K seeds are ranked
+    std::chrono::steady_clock::time_point rankPublishedAt;
+
+    // Display order of the results table. It is rebuilt by a background
+    // thread when the sort order, the filter or the number of results
+    // changes, so drawing a frame only touches the visible rows.
+    struct ResultIndex {
+        std::vector<uint32_t> rows;
+        size_t covered = 0;   // results the index was built from
+        uint64_t version = 0; // resultsVersion the index was built from
+        int sortColumn = -1;  // RESULT_COL_*, -1 for search order
+        bool ascending = true;
+        std::string filter;
+    };
+    enum { RESULT_COL_NUMBER, RESULT_COL_SEED, RESULT_COL_NAME, RESULT_COL_COORDS, RESULT_COL_DISTANCE, RESULT_COL_ACTIONS };
+    ResultIndex resultIndex;  // guarded by structuresMutex
+    int resultSortColumn = RESULT_COL_NUMBER;
+    bool resultSortAscending = true;
+    char resultFilter[64] = "";
+    std::thread indexThread;
+    std::atomic<bool> indexBusy{false};
+    std::chrono::steady_clock::time_point indexStartedAt;
+
+    // Biome coverage constraint around the (base) structure
+    struct SurroundingBiome {
+        bool enabled = false;
+        int biomeId = plains;
+        int radius = 64;        // in blocks
+        float coverage = 0.8f;  // required fraction of the area
+    };
+    SurroundingBiome surroundingBiome;
+
+    // Areas with more 1:4 cells than this are sampled with monteCarloBiomes()
+    static const int coverageExactCells = 4096;
+
+    // Flattened biome tree shared read-only by all search threads
+    BiomeTreeFlat biomeTree;
+    bool biomeTreeReady = false;
+
+    // Small open-addressed (scale, x, y, z) -> biome cache for a single seed.
+    // Entries are tagged with a generation, so moving to the next seed only
+    // bumps the counter instead of clearing the table.
+    struct BiomeMemo {
+        struct Entry {
+            int x, y, z, scale;
+            int biome;
+            uint32_t gen;  // 0 marks an empty entry
+        };
+        static const int capacity = 4096;  // power of two
+        static const int maxProbe = 8;
+
+        std::vector<Entry> table = std::vector<Entry>(capacity, Entry{});
+        uint32_t gen = 1;
+
+        void reset() {
+            if (++gen == 0) {  // wrapped around, stale tags could match again
+                std::fill(table.begin(), table.end(), Entry{});
+                gen = 1;
+            }
         }
-    }
 
-    int getIndexFromStructureType(int structureType) {
-        switch(structureType) {
-            case Village: return 0;
-            case Desert_Pyramid: return 1;
-            case Jungle_Pyramid: return 2;
-            case Swamp_Hut: return 3;
-            case Igloo: return 4;
-            case Monument: return 5;
-            case Mansion: return 6;
-            case Outpost: return 7;
-            case Ancient_City: return 8;
-            case Ruined_Portal: return 9;
-            case Shipwreck: return 10;
-            default: return 0;
+        static size_t home(int scale, int x, int y, int z) {
+            uint64_t h = (uint32_t)x * 0x9E3779B97F4A7C15ULL;
+            h ^= (uint32_t)z * 0xC2B2AE3D27D4EB4FULL;
+            h ^= (uint32_t)(y * 64 + scale) * 0x165667B19E3779F9ULL;
+            return (size_t)(h >> 32) & (capacity - 1);
         }
-    }
 
-    void startSearch() {
-        if (isSearching) {
-            stopSearch();
+        bool get(int scale, int x, int y, int z, int* biome) const {
+            size_t i = home(scale, x, y, z);
+            for (int n = 0; n < maxProbe; n++, i = (i + 1) & (capacity - 1)) {
+                const Entry& e = table[i];
+                if (e.gen != gen) return false;  // free for this seed: not stored
+                if (e.x == x && e.z == z && e.y == y && e.scale == scale) {
+                    *biome = e.biome;
+                    return true;
+                }
+            }
+            return false;
         }
 
-        resetSearchMetrics();
-        
-        {
-            std::lock_guard<std::mutex> lock(structuresMutex);
-            structureNames.clear();
-            positions.clear();
-            foundSeeds.clear();
-            
-            if (multiStructureMode) {
-                for (auto& attached : attachedStructures) {
-                    if (attached.required) {
-                        attached.found = false;
-                    }
+        void put(int scale, int x, int y, int z, int biome) {
+            size_t i = home(scale, x, y, z);
+            size_t slot = i;  // overwrite the home entry if the probe run is full
+            for (int n = 0; n < maxProbe; n++, i = (i + 1) & (capacity - 1)) {
+                if (table[i].gen != gen) {
+                    slot = i;
+                    break;
                 }
             }
+            table[slot] = Entry{ x, y, z, scale, biome, gen };
         }
+    };
 
-        // Start the timer
-        searchStartTime = std::chrono::steady_clock::now();
-        timerRunning = true;
+    // Per-thread generator and biome lookup state for the seed being checked.
+    // All biome queries made for one seed (base structure, attached structures,
+    // surroundings) share the same warm-start hint into the biome tree.
+    struct SeedContext {
+        Generator g;
+        uint64_t biomeHint = 0;  // last resolved biome tree node, see climateToBiome()
+        BiomeMemo memo;          // biomes already looked up for this seed
+        std::vector<int> area;   // genBiomes() buffer for surroundings checks
+        std::vector<int> cell;   // genBiomes() buffer of one 1:4 cell, see biomeAt4()
+        int64_t seed = 0;
+        bool seeded = false;
+        int mc = 0;              // version the generators are set up for
+
+        // Single climate parameters for rejecting positions before applySeed(),
+        // seeded lazily. The NP_SHIFT slot holds the shift noise, as the depth
+        // (which shares the index) is never checked on its own.
+        BiomeNoise para[NP_MAX];
+        int paraSeeded = 0;  // bit mask of the seeded para[] entries
+        int64_t paraSeed = 0;
+
+        // Nether biome noise, seeded on its own so nether-only queries never
+        // pay for the overworld generator
+        NetherNoise nether;
+        int64_t netherSeed = 0;
+        bool netherSeeded = false;
+
+        // End generator and surface noise for the End city search. The surface
+        // noise is only initialized once a city passes the biome check.
+        Generator end;
+        SurfaceNoise endSurface;
+        int64_t endSeed = 0;
+        bool endSeeded = false;
+        bool endSurfaceSeeded = false;
+
+        // World spawn, estimated and then refined lazily for spawn-relative
+        // distances, see estimatedSpawn() and worldSpawn()
+        Pos spawnEstimate, spawn;
+        uint64_t spawnRng = 0;   // random state after the estimate, see refineSpawn()
+        int64_t spawnSeed = 0;
+        int spawnLevel = 0;  // 0: none, 1: estimated, 2: exact
+
+        // Attached structures with where findMultipleStructures() found them
+        std::vector<AttachedStructure> attached;
+        // Scores at or below this cannot enter the ranking
+        double rankCutoff = -INFINITY;
+    };
+
+    // The thread's generators, set up again when the search version changed
+    SeedContext& threadContext() {
+        static thread_local SeedContext ctx;
+
+        if (ctx.mc != mcVersion) {
+            setupGenerator(&ctx.g, mcVersion, 0);
+            if (mcVersion >= MC_1_18) {
+                if (biomeTreeReady) ctx.g.bn.ft = &biomeTree;
+                ctx.g.bn.hint = &ctx.biomeHint;
+            }
+            setupGenerator(&ctx.end, mcVersion, 0);
+            ctx.cell.clear();
+            ctx.mc = mcVersion;
+            ctx.seeded = false;
+            ctx.paraSeeded = 0;
+            ctx.netherSeeded = false;
+            ctx.endSeeded = false;
+            ctx.spawnLevel = 0;
+        }
+        return ctx;
+    }
+
+    // Applies the seed to the thread's generator, once per seed
+    Generator& seedGenerator(SeedContext& ctx, int64_t seed) {
+        if (!ctx.seeded || ctx.seed != seed) {
+            applySeed(&ctx.g, DIM_OVERWORLD, seed);
+            ctx.biomeHint = 0;
+            ctx.memo.reset();
+            ctx.seed = seed;
+            ctx.seeded = true;
+        }
+        return ctx.g;
+    }
+
+    // Approximate world spawn of the seed, once per seed
+    Pos estimatedSpawn(SeedContext& ctx, int64_t seed) {
+        if (ctx.spawnLevel == 0 || ctx.spawnSeed != seed) {
+            ctx.spawnEstimate = estimateSpawn(&seedGenerator(ctx, seed), &ctx.spawnRng);
+            ctx.spawnSeed = seed;
+            ctx.spawnLevel = 1;
+        }
+        return ctx.spawnEstimate;
+    }
+
+    // Exact world spawn of the seed, refined from the estimate once per seed
+    Pos worldSpawn(SeedContext& ctx, int64_t seed) {
+        Pos estimate = estimatedSpawn(ctx, seed);
+        if (ctx.spawnLevel < 2) {
+            ctx.spawn = refineSpawn(&seedGenerator(ctx, seed), estimate, ctx.spawnRng);
+            ctx.spawnLevel = 2;
+        }
+        return ctx.spawn;
+    }
+
+    // Whether p is between minDist and maxDist blocks from world spawn. The
+    // distance to the estimate rules out most positions, so the exact spawn
+    // is only searched for once a position could still pass.
+    bool withinSpawnDistance(SeedContext& ctx, int64_t seed, Pos p, int minDist, int maxDist, int* dist) {
+        Pos e = estimatedSpawn(ctx, seed);
+        double d = sqrt((double)(p.x - e.x)*(p.x - e.x) + (double)(p.z - e.z)*(p.z - e.z));
+        int margin = spawnRefineMargin(ctx.g.mc);
+        if (d > maxDist + margin || d < minDist - margin) return false;
+
+        Pos s = worldSpawn(ctx, seed);
+        *dist = (int)sqrt((double)(p.x - s.x)*(p.x - s.x) + (double)(p.z - s.z)*(p.z - s.z));
+        return *dist >= minDist && *dist <= maxDist;
+    }
+
+    static bool isNetherStructure(int structureType) {
+        return structureType == Bastion || structureType == Fortress ||
+               structureType == Ruined_Portal_N;
+    }
+
+    // Position 'p' of a structure of type 'type' in the coordinates of the
+    // dimension of 'baseType', where one nether block is 8 overworld blocks
+    static Pos inDimensionOf(int baseType, int type, Pos p) {
+        bool nether = isNetherStructure(type);
+        if (nether == isNetherStructure(baseType)) return p;
+        if (nether) return { p.x * 8, p.z * 8 };
+        return { p.x >> 3, p.z >> 3 };
+    }
+
+    // Seeds only the nether biome noise, once per seed
+    NetherNoise& seedNether(SeedContext& ctx, int64_t seed) {
+        if (!ctx.netherSeeded || ctx.netherSeed != seed) {
+            setNetherSeed(&ctx.nether, seed);
+            ctx.netherSeed = seed;
+            ctx.netherSeeded = true;
+        }
+        return ctx.nether;
+    }
+
+    // Biome check for nether structures. Bastion and fortress are already told
+    // apart by getBedrockStructurePos(); bastions additionally avoid basalt deltas.
+    bool checkNetherStructure(SeedContext& ctx, int64_t seed, int structureType, Pos p) {
+        if (structureType != Bastion) return true;
+        NetherNoise& nn = seedNether(ctx, seed);
+        int id = getNetherBiome(&nn, (p.x >> 4) * 4 + 2, 33 >> 2, (p.z >> 4) * 4 + 2, NULL);
+        return isViableFeatureBiome(ctx.g.mc, Bastion, id);
+    }
+
+    // Seeds only the End biome noise, once per seed
+    Generator& seedEnd(SeedContext& ctx, int64_t seed) {
+        if (!ctx.endSeeded || ctx.endSeed != seed) {
+            applySeed(&ctx.end, DIM_END, seed);
+            ctx.endSeed = seed;
+            ctx.endSeeded = true;
+            ctx.endSurfaceSeeded = false;
+        }
+        return ctx.end;
+    }
+
+    // End surface noise for the seed last given to seedEnd()
+    const SurfaceNoise& endSurface(SeedContext& ctx) {
+        if (!ctx.endSurfaceSeeded) {
+            initSurfaceNoise(&ctx.endSurface, DIM_END, ctx.endSeed);
+            ctx.endSurfaceSeeded = true;
+        }
+        return ctx.endSurface;
+    }
+
+    // Biome at scale 1:4, same as getBiomeAt(&g, 4, ...) without the allocation,
+    // memoized for the current seed. Layered versions generate the cell into
+    // the thread's single cell buffer.
+    int biomeAt4(SeedContext& ctx, int x, int y, int z) {
+        int id;
+        if (ctx.memo.get(4, x, y, z, &id))
+            return id;
+        if (ctx.g.mc >= MC_1_18) {
+            id = sampleBiomeNoise(&ctx.g.bn, NULL, x, y, z, &ctx.biomeHint, 0);
+        } else {
+            // sized once seeded, the layer buffers depend on the dimension
+            if (ctx.cell.empty())
+                ctx.cell.resize(getMinCacheSize(&ctx.g, 4, 1, 1, 1));
+            Range r = { 4, x, z, 1, 1, y, 1 };
+            id = genBiomes(&ctx.g, ctx.cell.data(), r) ? none : ctx.cell[0];
+        }
+        ctx.memo.put(4, x, y, z, id);
+        return id;
+    }
+
+    // Climate parameter limits of the biomes a structure is restricted to.
+    // Used as a cheap first tier: if the approximate climate around a position
+    // overlaps none of them, the exact biome cannot be on the whitelist either.
+    struct ClimateWhitelist {
+        std::vector<const int*> limits;  // from getBiomeParaLimits()
+        int bounds[NP_MAX][2];           // envelope of all limits
+        std::vector<int> checkOrder;     // parameters the envelope constrains
+        bool enabled = false;
+
+        bool mayContain(const int range[6][2]) const {
+            for (const int* bp : limits) {
+                int j;
+                for (j = 0; j < 6; j++) {
+                    if (range[j][0] > bp[2*j+1] || range[j][1] < bp[2*j+0])
+                        break;
+                }
+                if (j >= 6) return true;
+            }
+            return false;
+        }
+    };
+    ClimateWhitelist climateWhitelists[FEATURE_NUM];
+    // Octaves sampled per climate noise by the approximate tier
+    static const int approxOctaves = 2;
+
+    void initClimateWhitelists() {
+        for (int type = 0; type < FEATURE_NUM; type++) {
+            ClimateWhitelist& wl = climateWhitelists[type];
+            wl.limits.clear();
+            wl.checkOrder.clear();
+            wl.enabled = false;
+            if (type != Monument && type != Mansion && type != Shipwreck && type != Village)
+                continue;
+
+            bool complete = true;
+            for (int id = 0; id < 256; id++) {
+                if (!isOverworld(MC_NEWEST, id) || !isStructureBiome(type, id))
+                    continue;
+                const int* bp = getBiomeParaLimits(MC_NEWEST, id);
+                if (!bp) {
+                    complete = false;
+                    break;
+                }
+                wl.limits.push_back(bp);
+            }
+            wl.enabled = complete && !wl.limits.empty();
+            if (!wl.enabled)
+                continue;
+
+            for (int np = 0; np < NP_MAX; np++) {
+                wl.bounds[np][0] = INT_MAX;
+                wl.bounds[np][1] = INT_MIN;
+                for (const int* bp : wl.limits) {
+                    wl.bounds[np][0] = std::min(wl.bounds[np][0], bp[2*np+0]);
+                    wl.bounds[np][1] = std::max(wl.bounds[np][1], bp[2*np+1]);
+                }
+            }
+            // Continentalness and temperature first: they separate most biome
+            // groups and temperature only has a few octaves to seed
+            const int* ext = getBiomeParaExtremes(MC_NEWEST);
+            const int order[] = { NP_CONTINENTALNESS, NP_TEMPERATURE, NP_HUMIDITY, NP_EROSION, NP_WEIRDNESS };
+            for (int np : order) {
+                if (wl.bounds[np][0] > ext[2*np+0] || wl.bounds[np][1] < ext[2*np+1])
+                    wl.checkOrder.push_back(np);
+            }
+        }
+    }
+
+    const BiomeNoise& climatePara(SeedContext& ctx, int64_t seed, int nptype) {
+        if (ctx.paraSeed != seed) {
+            ctx.paraSeeded = 0;
+            ctx.paraSeed = seed;
+        }
+        if (!(ctx.paraSeeded & (1 << nptype))) {
+            if (nptype == NP_SHIFT)
+                setClimateShiftSeed(&ctx.para[nptype], seed, 0);
+            else
+                setClimateParaSeed(&ctx.para[nptype], seed, 0, nptype, -1);
+            ctx.paraSeeded |= 1 << nptype;
+        }
+        return ctx.para[nptype];
+    }
+
+    // Exact climate bounds of a structure's biome whitelist, checked one
+    // parameter at a time without applying the seed. Returns true if any
+    // parameter at the 1:4 position used by biomeAt4() is out of range.
+    bool climateRejectsBiome(SeedContext& ctx, int64_t seed, int structureType, const Pos& p) {
+        const ClimateWhitelist& wl = climateWhitelists[structureType];
+        if (ctx.g.mc < MC_1_18 || !wl.enabled || wl.checkOrder.empty()) return false;
+
+        double px, pz;
+        getClimateShift(&climatePara(ctx, seed, NP_SHIFT), p.x >> 2, p.z >> 2, &px, &pz);
+
+        for (int np : wl.checkOrder) {
+            // same float truncation as sampleBiomeNoise()
+            float v = (float) sampleClimatePara(&climatePara(ctx, seed, np), NULL, px, pz);
+            int64_t para = (int64_t)(10000.0F * v);
+            if (para < wl.bounds[np][0] || para > wl.bounds[np][1])
+                return true;
+        }
+        return false;
+    }
+
+    // Approximate tier of the biome whitelist check, at the same 1:4 position
+    // as biomeAt4(). Returns true only if the exact check is certain to fail.
+    bool approxRejectsBiome(SeedContext& ctx, int structureType, const Pos& p) {
+        const ClimateWhitelist& wl = climateWhitelists[structureType];
+        if (ctx.g.mc < MC_1_18 || !wl.enabled) return false;
+
+        int range[6][2];
+        sampleBiomeNoiseApprox(&ctx.g.bn, range, p.x >> 2, p.z >> 2, approxOctaves, 0);
+        return !wl.mayContain(range);
+    }
+
+public:
+    StructureFinder() : 
+        gen(rd())
+    {
+        // setupGenerator(&g, MC_NEWEST, 0);  // Initialize generator in constructor
+        biomeTreeReady = initBiomeTreeFlat(&biomeTree, MC_NEWEST);
+        initClimateWhitelists();
+
+        size_t recovered = results.open(resultJournalPath);
+        if (recovered > 0) {
+            currentStatus = "Recovered " + std::to_string(recovered) + " results of the last session";
+        }
+        candidates.open(candidatePath);
+        candidateQuery.open(candidateQueryPath);
+        hasCandidates = candidateQuery.get(0, &candidateEnvelope);
+        refreshBitmapList();
+    }
+
+    ~StructureFinder() {
+        stopSearch();
+        if (slimeThread.joinable()) {
+            slimeThread.join();
+        }
+        if (indexThread.joinable()) {
+            indexThread.join();
+        }
+        bitmapCancel = true;
+        if (bitmapThread.joinable()) {
+            bitmapThread.join();
+        }
+        if (biomeTreeReady) {
+            freeBiomeTreeFlat(&biomeTree);
+        }
+    }
+
+    const char* struct2str(int structureType) {
+        switch (structureType) {
+            case Village:           return "Village";
+            case Desert_Pyramid:    return "Desert Pyramid";
+            case Jungle_Pyramid:    return "Jungle Pyramid";
+            case Swamp_Hut:        return "Swamp Hut";
+            case Igloo:            return "Igloo";
+            case Monument:         return "Monument";
+            case Mansion:          return "Mansion";
+            case Outpost:          return "Outpost";
+            case Ancient_City:     return "Ancient City";
+            case Ruined_Portal:    return "Ruined Portal";
+            case Shipwreck:        return "Shipwreck";
+            case Bastion:          return "Bastion Remnant";
+            case Fortress:         return "Nether Fortress";
+            case Ruined_Portal_N:  return "Ruined Portal (Nether)";
+            case End_City:         return "End City";
+            default:               return "Unknown";
+        }
+    }
+
+    int getStructureTypeFromIndex(int index) {
+        switch(index) {
+            case 0: return Village;
+            case 1: return Desert_Pyramid;
+            case 2: return Jungle_Pyramid;
+            case 3: return Swamp_Hut;
+            case 4: return Igloo;
+            case 5: return Monument;
+            case 6: return Mansion;
+            case 7: return Outpost;
+            case 8: return Ancient_City;
+            case 9: return Ruined_Portal;
+            case 10: return Shipwreck;
+            case 11: return Bastion;
+            case 12: return Fortress;
+            case 13: return Ruined_Portal_N;
+            default: return Village;
+        }
+    }
+
+    int getIndexFromStructureType(int structureType) {
+        switch(structureType) {
+            case Village: return 0;
+            case Desert_Pyramid: return 1;
+            case Jungle_Pyramid: return 2;
+            case Swamp_Hut: return 3;
+            case Igloo: return 4;
+            case Monument: return 5;
+            case Mansion: return 6;
+            case Outpost: return 7;
+            case Ancient_City: return 8;
+            case Ruined_Portal: return 9;
+            case Shipwreck: return 10;
+            case Bastion: return 11;
+            case Fortress: return 12;
+            case Ruined_Portal_N: return 13;
+            default: return 0;
+        }
+    }
+
+    // Starts a search with the current settings. A refining search only
+    // re-checks the candidates of the last structure search.
+    void startSearch(bool refine = false) {
+        if (isSearching) {
+            stopSearch();
+        }
+
+        resetSearchMetrics();
+        for (StageStats& st : stageStats) {
+            st.nanos = 0;
+            st.calls = 0;
+            st.passes = 0;
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            results.clear();
+            resultsVersion++;
+            resultIndex = ResultIndex();
+
+            ranking = rankQuery.enabled && searchKind == SEARCH_STRUCTURES;
+            rankK = (size_t)std::clamp(rankQuery.k, 1, rankMaxK);
+            rankMetric = rankQuery.metric;
+            ranked.clear();
+            rankedSeeds.clear();
+            rankChanged = false;
+            rankThreshold = -INFINITY;
+        }
+
+        refining = refine && hasCandidates && searchKind == SEARCH_STRUCTURES;
+        if (searchKind == SEARCH_STRUCTURES && !refining) {
+            candidates.clear();
+            saveCandidateQuery(currentEnvelope());
+        }
+
+        // Start the timer
+        searchStartTime = std::chrono::steady_clock::now();
+        timerRunning = true;
         elapsedSearchTime = 0.0;
 
         shouldStop = false;
         isSearching = true;
+        searchComplete = false;
         
         try {
             searchThreads.clear();
+
+            // The quad search enumerates region bases instead of random seeds
+            if (searchKind == SEARCH_QUADS) {
+                int threads = std::max(1, appSettings.threadCount);
+                quadThreadsLeft = threads;
+                for (int i = 0; i < threads; i++) {
+                    searchThreads.emplace_back(&StructureFinder::quadScanWorker, this, i, threads);
+                }
+                return;
+            }
+
+            if (refining) {
+                int threads = std::max(1, appSettings.threadCount);
+                refineThreadsLeft = threads;
+                for (int i = 0; i < threads; i++) {
+                    searchThreads.emplace_back(&StructureFinder::refineWorker, this, i, threads);
+                }
+                return;
+            }
+
+            // A 32-bit structure search walks the seeds left by the bitmaps
+            // in order instead of drawing random ones
+            if (searchKind == SEARCH_STRUCTURES && useBitmaps && useBedrockRange) {
+                std::string used = mapSearchBitmaps();
+                if (!searchBitmaps.empty()) {
+                    int threads = std::max(1, appSettings.threadCount);
+                    bitmapNextWord = 0;
+                    bitmapThreadsLeft = threads;
+                    currentStatus = "Searching the seeds that pass " + used;
+                    for (int i = 0; i < threads; i++) {
+                        searchThreads.emplace_back(&StructureFinder::bitmapScanWorker, this, i);
+                    }
+                    return;
+                }
+            }
             
             // Pre-generate seed batches for each thread
             std::vector<std::vector<int64_t>> threadSeeds(appSettings.threadCount);
@@ -655,6 +2014,8 @@ public:
 
                         int statusCounter = 0;
                         size_t seedIndex = 0;
+                        std::vector<RankedResult> localRanked;
+                        auto lastMerge = std::chrono::steady_clock::now();
                         
                         while (!shouldStop) {
                             int64_t seedToCheck = (seedIndex < seedBatch.size()) ? 
@@ -669,14 +2030,34 @@ public:
                                 statusCounter = 0;
                             }
 
+                            if (ranking) {
+                                if ((statusCounter & 63) == 0 && !localRanked.empty() &&
+                                    std::chrono::steady_clock::now() - lastMerge >= std::chrono::milliseconds(rankMergeMillis)) {
+                                    mergeRanked(localRanked);
+                                    lastMerge = std::chrono::steady_clock::now();
+                                }
+                                // The thread's own K-th best can be ahead of the shared one
+                                SeedContext& ctx = threadContext();
+                                ctx.rankCutoff = rankThreshold.load(std::memory_order_relaxed);
+                                if (localRanked.size() >= rankK)
+                                    ctx.rankCutoff = std::max(ctx.rankCutoff, localRanked.front().score);
+                            }
+
                             Pos pos;
+                            Pos dimPos[DIMQ_NUM];
                             bool found = false;
+                            int matchCount = 0;
+                            double coverage = 0;
 
                             try {
-                                if (multiStructureMode) {
-                                    found = findMultipleStructures(seedToCheck, &pos);
+                                if (searchKind == SEARCH_BIOMES) {
+                                    found = findBiome(seedToCheck, &pos, &coverage);
+                                } else if (searchKind == SEARCH_RAVINES) {
+                                    found = findRavines(seedToCheck, &pos, &matchCount);
+                                } else if (searchKind == SEARCH_END_CITIES) {
+                                    found = findEndCities(seedToCheck, &pos, &matchCount);
                                 } else {
-                                    found = findStructure(seedToCheck, &pos, maxSearchRadius);
+                                    found = checkStructureQuery(seedToCheck, &pos, dimPos);
                                 }
                             } catch (const std::exception& e) {
                                 continue;
@@ -685,69 +2066,54 @@ public:
                             seedsChecked++;
                             
                             if (found) {
-                                std::lock_guard<std::mutex> lock(structuresMutex);
-                                
-                                if (multiStructureMode) {
-                                    // Create combined structure description
-                                    std::string structures = std::string(struct2str(baseStructureType)) + 
-                                                           " [" + std::to_string(pos.x) +
-                                                           ", " + std::to_string(pos.z) + "]";
-                                    
-                                    // Count enabled and found structures
-                                    int enabledCount = 0;
-                                    int foundCount = 0;
-                                    for (const auto& attached : attachedStructures) {
-                                        if (attached.required) {
-                                            enabledCount++;
-                                            if (attached.found) {
-                                                foundCount++;
-                                                structures += "\n+ " + std::string(struct2str(attached.structureType)) +
-                                                            " [" + std::to_string(attached.foundPos.x) +
-                                                            ", " + std::to_string(attached.foundPos.z) + "]";
-                                            }
-                                        }
+                                SearchResult r = {};
+                                r.seed = seedToCheck;
+                                r.kind = searchKind;
+                                r.mc = mcVersion;
+                                r.pos = pos;
+                                r.distance = (int)sqrt((double)pos.x*pos.x + (double)pos.z*pos.z);
+                                bool complete = true;
+
+                                if (searchKind == SEARCH_BIOMES) {
+                                    r.type = biomeQuery.biomeId;
+                                    r.value = (float)coverage;
+                                    if (biomeQuery.fromSpawn) {
+                                        // cached by findBiome()
+                                        Pos spawn = worldSpawn(threadContext(), seedToCheck);
+                                        r.distance = (int)sqrt(pow(pos.x - spawn.x, 2) + pow(pos.z - spawn.z, 2));
+                                        addResultExtra(r, EXTRA_SPAWN, DIMQ_OVERWORLD, spawn);
+                                    }
+                                    if (biomeQuery.areaEnabled) {
+                                        r.flags |= RESULT_AREA;
+                                        r.count = biomeQuery.areaSize;
                                     }
-                                    
-                                    // Only add to results if we found all required structures
-                                    if (foundCount == enabledCount || !continuousSearch) {
-                                        structureNames.push_back(structures);
-                                        positions.push_back(pos);
-                                        foundSeeds.push_back(seedToCheck);
-                                        
-                                        // Update status with found information
-                                        std::string foundMsg = "[FOUND] Seed: " + std::to_string(seedToCheck) + "\n";
-                                        foundMsg += "Base " + std::string(struct2str(baseStructureType)) +
-                                                  ": [" + std::to_string(pos.x) +
-                                                  ", " + std::to_string(pos.z) + "]";
-                                        
-                                        for (const auto& attached : attachedStructures) {
-                                            if (attached.required && attached.found) {
-                                                int dx = attached.foundPos.x - pos.x;
-                                                int dz = attached.foundPos.z - pos.z;
-                                                int distance = (int)sqrt(dx*dx + dz*dz);
-                                                
-                                                foundMsg += "\n" + std::string(struct2str(attached.structureType)) +
-                                                          ": [" + std::to_string(attached.foundPos.x) +
-                                                          ", " + std::to_string(attached.foundPos.z) + "]" +
-                                                          " (Distance: " + std::to_string(distance) + "m)";
-                                            }
-                                        }
-                                        currentStatus = foundMsg;
-                                        
-                                        if (!continuousSearch) {
-                                            shouldStop = true;
-                                            break;
-                                        }
+                                } else if (searchKind == SEARCH_RAVINES || searchKind == SEARCH_END_CITIES) {
+                                    r.count = matchCount;
+                                    if (searchKind == SEARCH_END_CITIES) {
+                                        r.type = End_City;
+                                        if (endCityQuery.shipOnly) r.flags |= RESULT_SHIP;
+                                    } else if (ravineQuery.giantOnly) {
+                                        r.flags |= RESULT_GIANT;
                                     }
                                 } else {
-                                    structureNames.push_back(struct2str(selectedStructure));
-                                    positions.push_back(pos);
-                                    foundSeeds.push_back(seedToCheck);
-                                    currentStatus = "[FOUND] Seed: " + std::to_string(seedToCheck) +
-                                                  " | Coords: [" + std::to_string(pos.x) +
-                                                  ", " + std::to_string(pos.z) + "]" +
-                                                  " | Distance: " + std::to_string((int)sqrt(pow(pos.x, 2) + pow(pos.z, 2))) + "m";
-                                    
+                                    complete = structureResult(r, dimPos);
+                                    // Optional attached structures are not part of the candidate query
+                                    if (complete || (ranking && rankMetric == RANK_CONSTRAINTS))
+                                        candidates.append(seedToCheck);
+                                }
+
+                                if (ranking) {
+                                    // Missing attached structures only lower the score of that metric
+                                    if (complete || rankMetric == RANK_CONSTRAINTS)
+                                        offerRanked(localRanked, rankK, { rankScore(r), r });
+                                    continue;
+                                }
+
+                                std::lock_guard<std::mutex> lock(structuresMutex);
+                                if (complete || !continuousSearch) {
+                                    results.append(r);
+                                    currentStatus = resultStatus(r);
+
                                     if (!continuousSearch) {
                                         shouldStop = true;
                                         break;
@@ -755,6 +2121,7 @@ public:
                                 }
                             }
                         }
+                        if (ranking) mergeRanked(localRanked);
                     } catch (const std::exception& e) {
                         std::lock_guard<std::mutex> lock(structuresMutex);
                         currentStatus = "⚠️ Thread error: " + std::string(e.what());
@@ -771,6 +2138,21 @@ public:
 
     void stopSearch() {
         shouldStop = true;
+        endSearch();
+        currentStatus = "⚠️ Search stopped";
+    }
+
+    // Whether every worker of a search with a fixed amount of work (the quad
+    // bases, the candidates or the seeds left by the bitmaps) has returned
+    bool scanFinished() {
+        if (searchKind == SEARCH_QUADS) return quadThreadsLeft == 0;
+        if (refining) return refineThreadsLeft == 0;
+        return !searchBitmaps.empty() && bitmapThreadsLeft == 0;
+    }
+
+    // Joins the search threads and saves what they found. The status of the
+    // search is left as it is.
+    void endSearch() {
         isSearching = false;
         
         // Stop the timer and calculate final time
@@ -790,7 +2172,14 @@ public:
             }
         }
         searchThreads.clear();
-        currentStatus = "⚠️ Search stopped";
+        unmapSearchBitmaps();
+        if (ranking) publishRanking(true);
+        results.flush();
+        if (searchKind == SEARCH_STRUCTURES && !refining && hasCandidates) {
+            candidates.flush();
+            candidateEnvelope.seedsChecked = seedsChecked;
+            saveCandidateQuery(candidateEnvelope);
+        }
     }
 
     void renderAboutTab() {
@@ -877,94 +2266,888 @@ public:
     }
 
     void renderRavineTab() {
-        ImGui::Text("Ravine Finder (Coming Soon)");
-        ImGui::TextWrapped("This feature will help you locate ravines in Minecraft Bedrock seeds.");
-        
-        // Placeholder for future ravine search functionality
-        ImGui::Separator();
-        ImGui::TextDisabled("Ravine search functionality is not yet implemented.");
-    }
-
-    void renderBiomeTab() {
-        ImGui::Text("Biome Finder (Coming Soon)");
-        ImGui::TextWrapped("This feature will help you find specific biomes in Minecraft Java and Bedrock seeds.");
-        
-        // Placeholder for future biome search functionality
+        ImGui::Text("Ravine Finder");
+        ImGui::TextWrapped("Find Minecraft Bedrock seeds with ravines near the origin.");
         ImGui::Separator();
-        ImGui::TextDisabled("Biome search functionality is not yet implemented.");
-    }
 
-    void saveSeedsToFile() {
-        if (foundSeeds.empty()) {
-            currentStatus = "⚠️ No seeds to save";
-            return;
-        }
+        ImGui::Checkbox("Giant Ravines Only", &ravineQuery.giantOnly);
 
-        // Open file dialog to choose save location
-        OPENFILENAMEA ofn;
-        char szFile[260] = {0};
-        ZeroMemory(&ofn, sizeof(ofn));
-        ofn.lStructSize = sizeof(ofn);
-        ofn.hwndOwner = NULL;
-        ofn.lpstrFile = szFile;
-        ofn.nMaxFile = sizeof(szFile);
-        ofn.lpstrFilter = "Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
-        ofn.nFilterIndex = 1;
-        ofn.lpstrFileTitle = NULL;
-        ofn.nMaxFileTitle = 0;
-        ofn.lpstrInitialDir = NULL;
-        ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST | OFN_OVERWRITEPROMPT;
-        ofn.lpstrDefExt = "txt";
+        ImGui::PushItemWidth(100);
+        ImGui::Text("Minimum Count:");
+        ImGui::SameLine();
+        ImGui::DragInt("##ravinecount", &ravineQuery.minCount, 0.1f, 1, 64);
 
-        if (GetSaveFileNameA(&ofn)) {
-            std::ofstream outFile(szFile);
-            if (outFile.is_open()) {
-                // Write header
-                outFile << "Chunk Biomes - Found Seeds\n";
-                outFile << "Structure: " << struct2str(selectedStructure) << "\n";
-                outFile << "Search Radius: " << maxSearchRadius << "\n";
-                outFile << "------------------------\n";
+        ImGui::Text("Within Radius:");
+        ImGui::SameLine();
+        ImGui::DragInt("##ravineradius", &ravineQuery.radius, 1.0f, 16, 10000);
+        ImGui::SameLine();
+        if (ImGui::Button("-##ravr", ImVec2(20, 0))) {
+            ravineQuery.radius = std::max(16, ravineQuery.radius - 16);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("+##ravr", ImVec2(20, 0))) {
+            ravineQuery.radius = std::min(10000, ravineQuery.radius + 16);
+        }
+        ImGui::PopItemWidth();
 
-                // Write seeds with their structure details
-                for (size_t i = 0; i < foundSeeds.size(); ++i) {
-                    outFile << "Seed: " << foundSeeds[i];
-                    
-                    // Add structure details if available
-                    if (i < structureNames.size() && i < positions.size()) {
-                        outFile << " - " << structureNames[i] 
-                                << " (X: " << positions[i].x 
-                                << ", Z: " << positions[i].z << ")";
-                    }
-                    outFile << "\n";
-                }
+        ImGui::Separator();
+        ImGui::Checkbox("Continuous Search##ravine", &continuousSearch);
 
-                outFile.close();
-                currentStatus = "✅ Seeds saved successfully to " + std::string(szFile);
-            } else {
-                currentStatus = "⚠️ Failed to open file for writing";
+        ImGui::Separator();
+        if (!isSearching) {
+            if (ImGui::Button("Start Search##ravine")) {
+                searchKind = SEARCH_RAVINES;
+                startSearch();
+            }
+        } else {
+            if (ImGui::Button("Stop Search##ravine")) {
+                stopSearch();
             }
         }
+
+        renderSearchResults();
     }
 
-    void renderSearchTab() {
-        ImGui::Text("Search Settings");
+    void renderEndCityTab() {
+        ImGui::Text("End City Finder");
+        ImGui::TextWrapped("Find Minecraft Bedrock seeds with End cities near the main island. "
+                           "Only the End generator is seeded, so this runs much faster than overworld searches.");
         ImGui::Separator();
 
-        // Structure Type Selection
-        ImGui::Text("Structure Finding Type:");
+        ImGui::Checkbox("With End Ship Only", &endCityQuery.shipOnly);
         ImGui::SameLine();
-        
-        // Mode selection
-        if (ImGui::RadioButton("Single", !multiStructureMode)) {
-            multiStructureMode = false;
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Generates the city pieces to find the ship (elytra). "
+                                   "Piece generation follows Java Edition and is not verified for Bedrock.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
         }
+
+        ImGui::PushItemWidth(100);
+        ImGui::Text("Minimum Count:");
         ImGui::SameLine();
-        if (ImGui::RadioButton("Multiple", multiStructureMode)) {
-            multiStructureMode = true;
-            if (attachedStructures.empty()) {
-                // Initialize with empty vector
-                attachedStructures.clear();
-            }
+        ImGui::DragInt("##endcitycount", &endCityQuery.minCount, 0.1f, 1, 64);
+
+        ImGui::Text("Within Radius:");
+        ImGui::SameLine();
+        ImGui::DragInt("##endcityradius", &endCityQuery.radius, 1.0f, 1024, 10000);
+        ImGui::SameLine();
+        if (ImGui::Button("-##endr", ImVec2(20, 0))) {
+            endCityQuery.radius = std::max(1024, endCityQuery.radius - 16);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("+##endr", ImVec2(20, 0))) {
+            endCityQuery.radius = std::min(10000, endCityQuery.radius + 16);
+        }
+        ImGui::PopItemWidth();
+
+        ImGui::Separator();
+        ImGui::Checkbox("Continuous Search##endcity", &continuousSearch);
+
+        ImGui::Separator();
+        if (!isSearching) {
+            if (ImGui::Button("Start Search##endcity")) {
+                searchKind = SEARCH_END_CITIES;
+                startSearch();
+            }
+        } else {
+            if (ImGui::Button("Stop Search##endcity")) {
+                stopSearch();
+            }
+        }
+
+        renderSearchResults();
+    }
+
+    // Scans every n-th block of the 2^32 quad bases and checks the seeds that
+    // place each quad near the origin
+    void quadScanWorker(int thread, int n) {
+        StructureConfig sconf;
+        getBedrockStructureConfig(Swamp_Hut, MC_NEWEST, &sconf);
+        const uint64_t block = UINT64_C(1) << 20;
+        std::vector<uint32_t> bases(1024);
+
+        for (uint64_t start = thread * block; start < (UINT64_C(1) << 32) && !shouldStop; start += n * block) {
+            int found = scanBedrockQuadBases(&sconf, quadQuery.maxOffset, start, block,
+                                             bases.data(), (int)bases.size());
+            if (found > (int)bases.size()) {
+                bases.resize(found);
+                scanBedrockQuadBases(&sconf, quadQuery.maxOffset, start, block, bases.data(), found);
+            }
+            for (int i = 0; i < found && !shouldStop; i++) {
+                checkQuadBase(sconf, bases[i]);
+            }
+            seedsChecked += block;
+
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            currentSeed = (int64_t)start;
+            if (currentStatus.rfind("[FOUND]", 0) != 0) {
+                char progress[64];
+                snprintf(progress, sizeof(progress), "[T%d] Scanned %.1f%% of the quad bases",
+                         thread, (start + block) * 100.0 / (UINT64_C(1) << 32));
+                currentStatus = progress;
+            }
+        }
+
+        if (--quadThreadsLeft == 0 && !shouldStop) {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            currentStatus = "✅ All 2^32 quad bases scanned, " + std::to_string(results.size()) + " seeds found";
+        }
+    }
+
+    // Reports the seeds for which the quad with base 'u' lies near the origin
+    // and all four huts are in swamps
+    void checkQuadBase(const StructureConfig& sconf, uint32_t u) {
+        // Swamp hut size for getOptimalAfk()
+        const int ax = 7, ay = 7, az = 9;
+
+        // The layout of the four huts is the same for every seed using this
+        // base, only shifted by whole regions
+        int32_t seed0 = getBedrockQuadSeed(&sconf, u, 0, 0);
+        Pos p[4];
+        for (int j = 0; j < 4; j++) {
+            p[j] = getBedrockFeaturePos(&sconf, (uint64_t)(int64_t)seed0, j & 1, j >> 1);
+        }
+        int spaces;
+        Pos afk = getOptimalAfk(p, ax, ay, az, &spaces);
+        if (spaces <= 3 * ax * az) return;  // not all four huts in reach
+
+        SeedContext& ctx = threadContext();
+        const int regionBlocks = sconf.regionSize * 16;
+        const int r = quadQuery.radius;
+        const int rr = r / regionBlocks + 1;
+
+        for (int regZ = -rr; regZ < rr; regZ++) {
+            for (int regX = -rr; regX < rr; regX++) {
+                Pos at = { afk.x + regX * regionBlocks, afk.z + regZ * regionBlocks };
+                if ((int64_t)at.x*at.x + (int64_t)at.z*at.z > (int64_t)r*r) continue;
+
+                int64_t seed = getBedrockQuadSeed(&sconf, u, regX, regZ);
+                bool viable = true;
+                for (int j = 0; j < 4 && viable; j++) {
+                    Pos hut = { p[j].x + regX * regionBlocks, p[j].z + regZ * regionBlocks };
+                    viable = isViableStructure(ctx, seed, Swamp_Hut, hut);
+                }
+                if (!viable) continue;
+
+                SearchResult res = {};
+                res.seed = seed;
+                res.kind = SEARCH_QUADS;
+                res.mc = mcVersion;
+                res.type = Swamp_Hut;
+                res.count = spaces;
+                res.pos = at;
+                res.distance = (int)sqrt((double)at.x*at.x + (double)at.z*at.z);
+
+                std::lock_guard<std::mutex> lock(structuresMutex);
+                if (shouldStop) return;
+                results.append(res);
+                currentStatus = resultStatus(res);
+                if (!continuousSearch) {
+                    shouldStop = true;
+                    return;
+                }
+            }
+        }
+    }
+
+    void renderQuadTab() {
+        ImGui::Text("Quad Witch Hut Finder");
+        ImGui::TextWrapped("Find Minecraft Bedrock seeds with four swamp huts in reach of one AFK spot. "
+                           "Every possible quad is enumerated once, for all seeds at the same time.");
+        ImGui::Separator();
+
+        ImGui::PushItemWidth(100);
+        ImGui::Text("Max Corner Offset:");
+        ImGui::SameLine();
+        ImGui::SliderInt("##quadoffset", &quadQuery.maxOffset, 0, 8);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("How many chunks each hut may be away from the inner corner of its region. "
+                                   "Larger values find more candidates but make the scan slower; "
+                                   "quads out of reach of a single AFK spot are dropped either way.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+
+        ImGui::Text("Within Radius:");
+        ImGui::SameLine();
+        ImGui::DragInt("##quadradius", &quadQuery.radius, 1.0f, 256, 30000);
+        ImGui::SameLine();
+        if (ImGui::Button("-##quadr", ImVec2(20, 0))) {
+            quadQuery.radius = std::max(256, quadQuery.radius - 512);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("+##quadr", ImVec2(20, 0))) {
+            quadQuery.radius = std::min(30000, quadQuery.radius + 512);
+        }
+        ImGui::PopItemWidth();
+
+        ImGui::Separator();
+        ImGui::Checkbox("Continuous Search##quad", &continuousSearch);
+
+        ImGui::Separator();
+        if (!isSearching) {
+            if (ImGui::Button("Start Search##quad")) {
+                searchKind = SEARCH_QUADS;
+                startSearch();
+            }
+        } else {
+            if (ImGui::Button("Stop Search##quad")) {
+                stopSearch();
+            }
+        }
+
+        renderSearchResults();
+    }
+
+    // Loads the slime bitmap of the query area from its cache file, or computes
+    // it on all search threads and writes the cache, then finds the clusters
+    void renderBitmapTab() {
+        static const int types[] = {
+            Village, Desert_Pyramid, Jungle_Pyramid, Swamp_Hut, Igloo, Monument, Mansion, Outpost,
+            Ancient_City, Ruined_Portal, Shipwreck, Bastion, Fortress, Ruined_Portal_N, End_City
+        };
+        static const char* radii[] = { "128", "256", "512", "1024", "2048", "4096" };
+
+        ImGui::Text("Structure Proximity Bitmaps");
+        ImGui::TextWrapped("One bit per 32-bit seed, set if the seed places the structure within the radius "
+                           "of (0, 0). A bitmap takes 512 MB of disk and is built once. Searches over the "
+                           "32-bit range with \"Use Placement Bitmaps\" then only check the seeds set in "
+                           "all the bitmaps of their query. Each version has its own bitmaps.");
+        ImGui::Separator();
+
+        renderVersionSelect();
+        ImGui::PushItemWidth(180);
+        if (ImGui::BeginCombo("Structure##bitmap", struct2str(types[bitmapStructureIndex]))) {
+            for (int i = 0; i < IM_ARRAYSIZE(types); i++) {
+                if (ImGui::Selectable(struct2str(types[i]), i == bitmapStructureIndex))
+                    bitmapStructureIndex = i;
+            }
+            ImGui::EndCombo();
+        }
+        ImGui::Combo("Radius (blocks)##bitmap", &bitmapRadiusIndex, radii, IM_ARRAYSIZE(radii));
+        ImGui::PopItemWidth();
+
+        if (!bitmapBusy) {
+            if (ImGui::Button("Build Bitmap")) {
+                if (bitmapThread.joinable()) bitmapThread.join();
+                bitmapBusy = true;
+                bitmapCancel = false;
+                bitmapProgress = 0;
+                bitmapThread = std::thread(&StructureFinder::runBitmapBuild, this,
+                                           types[bitmapStructureIndex], mcVersion,
+                                           proximityRadii[bitmapRadiusIndex]);
+            }
+        } else {
+            if (ImGui::Button("Cancel Build")) {
+                bitmapCancel = true;
+            }
+            ImGui::SameLine();
+            ImGui::ProgressBar((float)(bitmapProgress.load() / 4294967296.0), ImVec2(200, 0));
+        }
+
+        std::lock_guard<std::mutex> lock(structuresMutex);
+        if (!bitmapStatus.empty()) {
+            ImGui::TextWrapped("%s", bitmapStatus.c_str());
+        }
+        if (!builtBitmaps.empty() && ImGui::BeginTable("Bitmaps", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Structure");
+            ImGui::TableSetupColumn("Radius");
+            ImGui::TableHeadersRow();
+            for (const auto& b : builtBitmaps) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(struct2str(b.first));
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", b.second);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    void runSlimeQuery(SlimeQuery q) {
+        auto setStatus = [this](const std::string& text) {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            slimeStatus = text;
+        };
+        auto start = std::chrono::steady_clock::now();
+        auto seconds = [&start]() {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.2fs", std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count());
+            return std::string(buf);
+        };
+
+        int x0 = q.centerX - q.halfSize, z0 = q.centerZ - q.halfSize;
+        int size = 2 * q.halfSize + 1;
+        std::string path = "slime_" + std::to_string(x0) + "_" + std::to_string(z0) +
+                           "_" + std::to_string(size) + ".bin";
+
+        SlimeBitmap sb;
+        std::string source;
+        if (loadSlimeBitmap(&sb, path.c_str(), x0, z0, size, size)) {
+            source = "loaded " + path;
+        } else {
+            if (!allocSlimeBitmap(&sb, x0, z0, size, size)) {
+                setStatus("⚠️ Not enough memory for the slime chunk bitmap");
+                slimeBusy = false;
+                return;
+            }
+            setStatus("Computing slime chunks...");
+            int n = std::max(1, appSettings.threadCount);
+            std::vector<std::thread> workers;
+            for (int i = 0; i < n; i++) {
+                workers.emplace_back([&sb, i, n]() {
+                    fillSlimeBitmap(&sb, sb.h * i / n, sb.h * (i + 1) / n);
+                });
+            }
+            for (auto& t : workers) t.join();
+            source = saveSlimeBitmap(&sb, path.c_str()) ? "cached to " + path
+                                                        : "could not write " + path;
+        }
+
+        setStatus("Finding clusters...");
+        std::vector<SlimeCluster> found(std::max(1, q.resultCount));
+        int n = findSlimeClusters(&sb, q.afkRadius, found.data(), (int)found.size());
+        found.resize(n);
+        freeSlimeBitmap(&sb);
+
+        {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            slimeClusters = found;
+            slimeStatus = "Done in " + seconds() + ", " + source;
+        }
+        slimeBusy = false;
+    }
+
+    void renderSlimeTab() {
+        ImGui::Text("Slime Chunk Finder");
+        ImGui::TextWrapped("Find the AFK spots with the most slime chunks around them. "
+                           "Bedrock slime chunks are the same in every world, so no seed is needed.");
+        ImGui::Separator();
+
+        ImGui::PushItemWidth(100);
+        ImGui::Text("Area Center (chunks):");
+        ImGui::SameLine();
+        ImGui::DragInt("X##slimecx", &slimeQuery.centerX, 1.0f, -1800000, 1800000);
+        ImGui::SameLine();
+        ImGui::DragInt("Z##slimecz", &slimeQuery.centerZ, 1.0f, -1800000, 1800000);
+
+        ImGui::Text("Area Radius (chunks):");
+        ImGui::SameLine();
+        ImGui::DragInt("##slimesize", &slimeQuery.halfSize, 16.0f, 32, 16384);
+        ImGui::SameLine();
+        if (ImGui::Button("-##slimes", ImVec2(20, 0))) {
+            slimeQuery.halfSize = std::max(32, slimeQuery.halfSize / 2);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("+##slimes", ImVec2(20, 0))) {
+            slimeQuery.halfSize = std::min(16384, slimeQuery.halfSize * 2);
+        }
+
+        ImGui::Text("AFK Radius (chunks):");
+        ImGui::SameLine();
+        ImGui::SliderInt("##slimeafk", &slimeQuery.afkRadius, 1, 31);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Chunks whose center is within this many chunks of the AFK chunk are "
+                                   "counted, e.g. 8 chunks for a 128 block spawning range");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+
+        ImGui::Text("Results:");
+        ImGui::SameLine();
+        ImGui::SliderInt("##slimeresults", &slimeQuery.resultCount, 1, 100);
+        ImGui::PopItemWidth();
+
+        ImGui::Separator();
+        if (!slimeBusy) {
+            if (ImGui::Button("Find Clusters")) {
+                if (slimeThread.joinable()) slimeThread.join();
+                slimeBusy = true;
+                slimeThread = std::thread(&StructureFinder::runSlimeQuery, this, slimeQuery);
+            }
+        } else {
+            ImGui::TextDisabled("Working...");
+        }
+
+        std::lock_guard<std::mutex> lock(structuresMutex);
+        if (!slimeStatus.empty()) {
+            ImGui::TextWrapped("%s", slimeStatus.c_str());
+        }
+        if (!slimeClusters.empty() && ImGui::BeginTable("SlimeClusters", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Slime Chunks");
+            ImGui::TableSetupColumn("AFK Block");
+            ImGui::TableSetupColumn("AFK Chunk");
+            ImGui::TableHeadersRow();
+            for (const SlimeCluster& c : slimeClusters) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", c.count);
+                ImGui::TableNextColumn();
+                ImGui::Text("%d, %d", c.x * 16 + 8, c.z * 16 + 8);
+                ImGui::TableNextColumn();
+                ImGui::Text("%d, %d", c.x, c.z);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    void renderBiomeTab() {
+        ImGui::Text("Biome Finder");
+        ImGui::TextWrapped("Find seeds with a biome near the origin or world spawn, e.g. mushroom fields "
+                           "within 1000 blocks.");
+        ImGui::Separator();
+
+        renderVersionSelect();
+        ImGui::PushItemWidth(160);
+        biomeCombo("Biome##finder", &biomeQuery.biomeId);
+        float percent = biomeQuery.minCoverage * 100.0f;
+        if (ImGui::SliderFloat("Minimum Coverage", &percent, 0.0f, 100.0f, "%.1f%%")) {
+            biomeQuery.minCoverage = percent / 100.0f;
+        }
+        ImGui::PopItemWidth();
+
+        ImGui::PushItemWidth(100);
+        ImGui::Text("Within Radius:");
+        ImGui::SameLine();
+        ImGui::DragInt("##biomeradius", &biomeQuery.radius, 1.0f, 16, 10000);
+        ImGui::SameLine();
+        if (ImGui::Button("-##biomer", ImVec2(20, 0))) {
+            biomeQuery.radius = std::max(16, biomeQuery.radius - 64);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("+##biomer", ImVec2(20, 0))) {
+            biomeQuery.radius = std::min(10000, biomeQuery.radius + 64);
+        }
+        ImGui::PopItemWidth();
+
+        ImGui::Checkbox("Centered on World Spawn", &biomeQuery.fromSpawn);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Search around world spawn instead of (0, 0). The spawn is computed for "
+                                   "every seed before its biomes, which makes the search slower. It follows "
+                                   "the Java Edition spawn search, so it can be off on some Bedrock seeds.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+
+        ImGui::Checkbox("Contiguous Area", &biomeQuery.areaEnabled);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Require an unbroken square of the biome inside the search square, "
+                                   "e.g. a 256x256 block plains area within 1000 blocks");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+        if (biomeQuery.areaEnabled) {
+            ImGui::PushItemWidth(100);
+            ImGui::Text("Square Side:");
+            ImGui::SameLine();
+            ImGui::DragInt("##biomearea", &biomeQuery.areaSize, 1.0f, 4, 2048);
+            ImGui::SameLine();
+            if (ImGui::Button("-##biomea", ImVec2(20, 0))) {
+                biomeQuery.areaSize = std::max(4, biomeQuery.areaSize - 16);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("+##biomea", ImVec2(20, 0))) {
+                biomeQuery.areaSize = std::min(2048, biomeQuery.areaSize + 16);
+            }
+            ImGui::SameLine();
+            ImGui::Text("blocks");
+            ImGui::PopItemWidth();
+        }
+
+        ImGui::Separator();
+        ImGui::Checkbox("Continuous Search##biome", &continuousSearch);
+
+        ImGui::Separator();
+        if (!isSearching) {
+            if (ImGui::Button("Start Search##biome")) {
+                searchKind = SEARCH_BIOMES;
+                startSearch();
+            }
+        } else {
+            if (ImGui::Button("Stop Search##biome")) {
+                stopSearch();
+            }
+        }
+
+        renderSearchResults();
+    }
+
+    // Exports the results as text, or as CSV with one row per result
+    void saveSeedsToFile(bool csv = false) {
+        size_t count = results.size();
+        if (count == 0) {
+            currentStatus = "⚠️ No seeds to save";
+            return;
+        }
+
+        // Open file dialog to choose save location
+        OPENFILENAMEA ofn;
+        char szFile[260] = {0};
+        ZeroMemory(&ofn, sizeof(ofn));
+        ofn.lStructSize = sizeof(ofn);
+        ofn.hwndOwner = NULL;
+        ofn.lpstrFile = szFile;
+        ofn.nMaxFile = sizeof(szFile);
+        ofn.lpstrFilter = csv ? "CSV Files (*.csv)\0*.csv\0All Files (*.*)\0*.*\0"
+                              : "Text Files (*.txt)\0*.txt\0All Files (*.*)\0*.*\0";
+        ofn.nFilterIndex = 1;
+        ofn.lpstrFileTitle = NULL;
+        ofn.nMaxFileTitle = 0;
+        ofn.lpstrInitialDir = NULL;
+        ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST | OFN_OVERWRITEPROMPT;
+        ofn.lpstrDefExt = csv ? "csv" : "txt";
+
+        if (GetSaveFileNameA(&ofn)) {
+            std::ofstream outFile(szFile);
+            if (outFile.is_open() && csv) {
+                writeResultsCsv(outFile, count);
+                currentStatus = "✅ Seeds exported successfully to " + std::string(szFile);
+            } else if (outFile.is_open()) {
+                // Write header
+                outFile << "Chunk Biomes - Found Seeds\n";
+                if (searchKind == SEARCH_BIOMES) {
+                    outFile << "Biome: " << biome2str(mcVersion, biomeQuery.biomeId)
+                            << " (coverage at least " << biomeQuery.minCoverage * 100.0f << "%)\n";
+                    outFile << "Search Radius: " << biomeQuery.radius
+                            << (biomeQuery.fromSpawn ? " (from world spawn)" : "") << "\n";
+                } else if (searchKind == SEARCH_RAVINES) {
+                    outFile << "Structure: " << (ravineQuery.giantOnly ? "Giant Ravine" : "Ravine")
+                            << " (at least " << ravineQuery.minCount << ")\n";
+                    outFile << "Search Radius: " << ravineQuery.radius << "\n";
+                } else if (searchKind == SEARCH_QUADS) {
+                    outFile << "Structure: Quad Swamp Hut (at most " << quadQuery.maxOffset
+                            << " chunks from the corners)\n";
+                    outFile << "Search Radius: " << quadQuery.radius << "\n";
+                } else if (searchKind == SEARCH_END_CITIES) {
+                    outFile << "Structure: " << (endCityQuery.shipOnly ? "End City with Ship" : "End City")
+                            << " (at least " << endCityQuery.minCount << ")\n";
+                    outFile << "Search Radius: " << endCityQuery.radius << "\n";
+                } else {
+                    outFile << "Structure: " << struct2str(selectedStructure) << "\n";
+                    outFile << "Search Radius: " << maxSearchRadius
+                            << (spawnRelative ? " (from world spawn)" : "") << "\n";
+                }
+                outFile << "------------------------\n";
+
+                // Write seeds with their structure details, read back from
+                // the journal one at a time
+                SearchResult r;
+                for (size_t i = 0; i < count && results.get(i, &r); i++) {
+                    outFile << "Seed: " << r.seed << " - " << resultLabel(r)
+                            << " (X: " << r.pos.x << ", Z: " << r.pos.z << ")\n";
+                    for (int k = 0; k < r.extraCount; k++) {
+                        const ResultExtra& e = r.extras[k];
+                        outFile << "    + " << extraLabel(e)
+                                << " (X: " << e.pos.x << ", Z: " << e.pos.z << ")\n";
+                    }
+                }
+
+                outFile.close();
+                currentStatus = "✅ Seeds saved successfully to " + std::string(szFile);
+            } else {
+                currentStatus = "⚠️ Failed to open file for writing";
+            }
+        }
+    }
+
+    // One CSV row per result. The extra structures go into a single column
+    // as "label x z" entries separated by semicolons.
+    void writeResultsCsv(std::ostream& out, size_t count) {
+        out << "seed,structure,x,z,distance,extras\n";
+        SearchResult r;
+        for (size_t i = 0; i < count && results.get(i, &r); i++) {
+            out << r.seed << ",\"" << resultLabel(r) << "\"," << r.pos.x << "," << r.pos.z << ","
+                << r.distance << ",\"";
+            for (int k = 0; k < r.extraCount; k++) {
+                const ResultExtra& e = r.extras[k];
+                out << (k ? "; " : "") << extraLabel(e) << " " << e.pos.x << " " << e.pos.z;
+            }
+            out << "\"\n";
+        }
+    }
+
+    // Combo box over all overworld biomes of the search version
+    bool biomeCombo(const char* label, int* biomeId) {
+        static std::vector<int> biomeIds;
+        static std::vector<const char*> biomeNames;
+        static int listedVersion = -1;
+        if (listedVersion != mcVersion) {
+            biomeIds.clear();
+            biomeNames.clear();
+            for (int id = 0; id < 256; id++) {
+                if (isOverworld(mcVersion, id)) {
+                    biomeIds.push_back(id);
+                    biomeNames.push_back(biome2str(mcVersion, id));
+                }
+            }
+            listedVersion = mcVersion;
+        }
+
+        int biomeIndex = 0;
+        for (size_t i = 0; i < biomeIds.size(); i++) {
+            if (biomeIds[i] == *biomeId) biomeIndex = (int)i;
+        }
+        if (ImGui::Combo(label, &biomeIndex, biomeNames.data(), (int)biomeNames.size())) {
+            *biomeId = biomeIds[biomeIndex];
+            return true;
+        }
+        return false;
+    }
+
+    void renderSurroundingBiomeSettings() {
+        ImGui::Checkbox("Surrounding Biome", &surroundingBiome.enabled);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Require the area around the (base) structure to be mostly one biome, "
+                                   "e.g. a village surrounded by 80% plains within 64 blocks");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+
+        if (!surroundingBiome.enabled) return;
+
+        ImGui::PushItemWidth(160);
+        biomeCombo("Biome##surrounding", &surroundingBiome.biomeId);
+
+        float percent = surroundingBiome.coverage * 100.0f;
+        if (ImGui::SliderFloat("Coverage##surrounding", &percent, 1.0f, 100.0f, "%.0f%%")) {
+            surroundingBiome.coverage = percent / 100.0f;
+        }
+        ImGui::PopItemWidth();
+
+        ImGui::PushItemWidth(100);
+        ImGui::Text("Within:");
+        ImGui::SameLine();
+        ImGui::DragInt("##surroundradius", &surroundingBiome.radius, 1.0f, 4, 2048);
+        ImGui::SameLine();
+        if (ImGui::Button("-##surr", ImVec2(20, 0))) {
+            surroundingBiome.radius = std::max(4, surroundingBiome.radius - 16);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("+##surr", ImVec2(20, 0))) {
+            surroundingBiome.radius = std::min(2048, surroundingBiome.radius + 16);
+        }
+        ImGui::SameLine();
+        ImGui::Text("blocks");
+        ImGui::PopItemWidth();
+        ImGui::Separator();
+    }
+
+    // Size of the candidate set, and what a refinement with the current
+    // settings would miss
+    void renderCandidateInfo() {
+        if (!hasCandidates || (isSearching && !refining)) return;
+        ImGui::Text("Candidates: %zu seeds kept from %lld checked", candidates.size(),
+                    (long long)candidateEnvelope.seedsChecked);
+        std::vector<std::string> looser = loosenedConstraints(candidateEnvelope, currentEnvelope());
+        if (looser.empty()) {
+            ImGui::TextDisabled("The query is as strict as the candidates' query, refining finds every match");
+            return;
+        }
+        ImVec4 warn(1.0f, 0.6f, 0.0f, 1.0f);
+        ImGui::TextColored(warn, "Refining only finds the matches among the candidates. "
+                                 "A new search is needed for seeds that only match:");
+        for (const std::string& line : looser) {
+            ImGui::TextColored(warn, "  %s", line.c_str());
+        }
+    }
+
+    void renderRankSettings() {
+        static const char* metrics[] = { "Closest to origin", "Tightest cluster", "Most attached structures" };
+
+        // The running search keeps the ranking it was started with
+        ImGui::BeginDisabled(isSearching);
+        ImGui::Checkbox("Rank Best Seeds", &rankQuery.enabled);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Search until stopped and keep only the best scoring seeds, best first. "
+                                   "Closest: distance of the (base) structure from the origin or spawn. "
+                                   "Cluster: distance from the base to its farthest attached structure. "
+                                   "Most attached: attached structures become optional and each one "
+                                   "found counts, ties go to the closest base. Once the list is full, "
+                                   "structures that could not beat the last seed are skipped.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+        if (!rankQuery.enabled) {
+            ImGui::EndDisabled();
+            return;
+        }
+
+        ImGui::PushItemWidth(180);
+        ImGui::Combo("Score", &rankQuery.metric, metrics, IM_ARRAYSIZE(metrics));
+        ImGui::SameLine();
+        ImGui::PushItemWidth(100);
+        if (ImGui::InputInt("Seeds to keep", &rankQuery.k, 10, 100)) {
+            rankQuery.k = std::clamp(rankQuery.k, 1, rankMaxK);
+        }
+        ImGui::PopItemWidth();
+        ImGui::PopItemWidth();
+        ImGui::EndDisabled();
+    }
+
+    void renderDimensionQuerySettings() {
+        static const char* dimNames[DIMQ_NUM] = { "Overworld", "Nether", "End" };
+        static const char* overworldStructures[] = {
+            "Village", "Desert Pyramid", "Jungle Pyramid", "Swamp Hut",
+            "Igloo", "Monument", "Mansion", "Outpost",
+            "Ancient City", "Ruined Portal", "Shipwreck"
+        };
+        static const char* netherStructures[] = {
+            "Bastion Remnant", "Nether Fortress", "Ruined Portal (Nether)"
+        };
+
+        ImGui::Text("Other Dimensions:");
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Also require a structure near the origin of each enabled dimension, "
+                                   "e.g. a bastion within 150 blocks of the Nether origin. "
+                                   "The cheapest checks run first, a dimension is only generated for seeds "
+                                   "that passed them.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+
+        for (int d = 0; d < DIMQ_NUM; d++) {
+            DimensionQuery& dq = dimensionQueries[d];
+            std::string id = std::to_string(d);
+            ImGui::Checkbox((std::string(dimNames[d]) + "##dimq" + id).c_str(), &dq.enabled);
+            if (!dq.enabled) continue;
+
+            ImGui::SameLine(110);
+            ImGui::PushItemWidth(180);
+            if (d == DIMQ_OVERWORLD) {
+                int index = getIndexFromStructureType(dq.structureType);
+                if (ImGui::Combo(("##dimqtype" + id).c_str(), &index, overworldStructures, IM_ARRAYSIZE(overworldStructures))) {
+                    dq.structureType = getStructureTypeFromIndex(index);
+                }
+            } else if (d == DIMQ_NETHER) {
+                int index = getIndexFromStructureType(dq.structureType) - 11;
+                if (ImGui::Combo(("##dimqtype" + id).c_str(), &index, netherStructures, IM_ARRAYSIZE(netherStructures))) {
+                    dq.structureType = getStructureTypeFromIndex(index + 11);
+                }
+            } else {
+                ImGui::Text("%s", struct2str(dq.structureType));
+            }
+            ImGui::PopItemWidth();
+
+            ImGui::SameLine();
+            ImGui::Text("within");
+            ImGui::SameLine();
+            ImGui::PushItemWidth(60);
+            ImGui::DragInt(("##dimqdist" + id).c_str(), &dq.maxDistance, 1.0f, 16, 10000);
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            if (ImGui::Button(("-##dimqd" + id).c_str(), ImVec2(20, 0))) {
+                dq.maxDistance = std::max(16, dq.maxDistance - 16);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button(("+##dimqd" + id).c_str(), ImVec2(20, 0))) {
+                dq.maxDistance = std::min(10000, dq.maxDistance + 16);
+            }
+        }
+
+        // Check order chosen by the planner with the measured cost per seed
+        int order[STAGE_NUM];
+        int n = planStages(order);
+        if (n > 1) {
+            std::string plan = "Check order:";
+            for (int i = 0; i < n; i++) {
+                int st = order[i];
+                uint64_t calls = stageStats[st].calls.load(std::memory_order_relaxed);
+                plan += (i ? " > " : " ") + std::string(st == STAGE_BASE ? "Structures" : dimNames[st]);
+                if (calls > 0) {
+                    char cost[32];
+                    snprintf(cost, sizeof(cost), " (%.1f us)", stageStats[st].nanos.load(std::memory_order_relaxed) / 1000.0 / calls);
+                    plan += cost;
+                }
+            }
+            ImGui::TextDisabled("%s", plan.c_str());
+        }
+        ImGui::Separator();
+    }
+
+    // Game version of the searches. Changing it while threads are running
+    // would swap their generators mid-seed, so it is locked during a search.
+    void renderVersionSelect() {
+        static const int versions[] = { MC_NEWEST, MC_1_17, MC_1_16, MC_1_15, MC_1_14 };
+        static const char* names[] = { "1.18+ (latest)", "1.17", "1.16", "1.15", "1.14" };
+        int index = 0;
+        for (int i = 0; i < IM_ARRAYSIZE(versions); i++) {
+            if (versions[i] == mcVersion) index = i;
+        }
+        ImGui::BeginDisabled(isSearching);
+        ImGui::PushItemWidth(160);
+        if (ImGui::Combo("Minecraft Version", &index, names, IM_ARRAYSIZE(names))) {
+            mcVersion = versions[index];
+            refreshBitmapList();
+        }
+        ImGui::PopItemWidth();
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Bedrock worlds up to 1.17 generate their biomes in layers. Searches for these "
+                                   "versions reject most areas at the coarse layers, before any biome is "
+                                   "generated at full resolution.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+    }
+
+    void renderSearchTab() {
+        ImGui::Text("Search Settings");
+        ImGui::Separator();
+
+        renderVersionSelect();
+
+        // Structure Type Selection
+        ImGui::Text("Structure Finding Type:");
+        ImGui::SameLine();
+        
+        // Mode selection
+        if (ImGui::RadioButton("Single", !multiStructureMode)) {
+            multiStructureMode = false;
+        }
+        ImGui::SameLine();
+        if (ImGui::RadioButton("Multiple", multiStructureMode)) {
+            multiStructureMode = true;
+            if (attachedStructures.empty()) {
+                // Initialize with empty vector
+                attachedStructures.clear();
+            }
         }
 
         // Seed Range Selection
@@ -1003,8 +3186,23 @@ public:
             );
             ImGui::EndTooltip();
         }
-        
-        ImGui::PopStyleVar();
+        
+        ImGui::PopStyleVar();
+
+        if (useBedrockRange) {
+            ImGui::Checkbox("Use Placement Bitmaps", &useBitmaps);
+            ImGui::SameLine();
+            ImGui::TextDisabled("(?)");
+            if (ImGui::IsItemHovered()) {
+                ImGui::BeginTooltip();
+                ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+                ImGui::TextUnformatted("Scan all 2^32 seeds in order, skipping the seeds that the structure "
+                                       "bitmaps built in the Bitmaps tab rule out. Bitmaps are used for the "
+                                       "structure, attached and dimension constraints measured from (0, 0).");
+                ImGui::PopTextWrapPos();
+                ImGui::EndTooltip();
+            }
+        }
         ImGui::Separator();
 
         if (!multiStructureMode) {
@@ -1012,7 +3210,8 @@ public:
             const char* structures[] = {
                 "Village", "Desert Pyramid", "Jungle Pyramid", "Swamp Hut",
                 "Igloo", "Monument", "Mansion", "Outpost", 
-                "Ancient City", "Ruined Portal", "Shipwreck"
+                "Ancient City", "Ruined Portal", "Shipwreck",
+                "Bastion Remnant", "Nether Fortress", "Ruined Portal (Nether)"
             };
             static int structureIndex = 0;
             if (ImGui::Combo("Structure Type", &structureIndex, structures, IM_ARRAYSIZE(structures))) {
@@ -1026,7 +3225,8 @@ public:
             const char* structures[] = {
                 "Village", "Desert Pyramid", "Jungle Pyramid", "Swamp Hut",
                 "Igloo", "Monument", "Mansion", "Outpost", 
-                "Ancient City", "Ruined Portal", "Shipwreck"
+                "Ancient City", "Ruined Portal", "Shipwreck",
+                "Bastion Remnant", "Nether Fortress", "Ruined Portal (Nether)"
             };
             static int baseIndex = 0;
             if (ImGui::Combo("Base Structure", &baseIndex, structures, IM_ARRAYSIZE(structures))) {
@@ -1095,7 +3295,7 @@ public:
             ImGui::PopStyleColor(3);
 
             if (ImGui::Button("Add Structure")) {
-                if (attachedStructures.size() < 5) { // Limit to 5 attached structures
+                if (attachedStructures.size() < MAX_ATTACHED) {
                     attachedStructures.push_back(AttachedStructure());
                 }
             }
@@ -1107,6 +3307,9 @@ public:
             ImGui::EndChild();
         }
 
+        renderSurroundingBiomeSettings();
+        renderDimensionQuerySettings();
+
         // Rest of the original UI (radius, continuous search, etc.)
         ImGui::PushItemWidth(120);
         ImGui::Text("Search Radius:");
@@ -1144,6 +3347,20 @@ public:
         ImGui::EndGroup();
         ImGui::PopItemWidth();
 
+        ImGui::Checkbox("Measure from World Spawn", &spawnRelative);
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Measure the search radius and the overworld constraint from world spawn "
+                                   "instead of (0, 0). The spawn is only computed for seeds with a structure "
+                                   "near its cheap estimate. It follows the Java Edition spawn search, so it "
+                                   "can be off on some Bedrock seeds.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+
         // Continuous Search Checkbox
         ImGui::Separator();
         ImGui::Checkbox("Continuous Search", &continuousSearch);
@@ -1156,19 +3373,37 @@ public:
             ImGui::PopTextWrapPos();
             ImGui::EndTooltip();
         }
+        renderRankSettings();
 
         // Start/Stop Search Buttons
         ImGui::Separator();
         if (!isSearching) {
             if (ImGui::Button("Start Search")) {
+                searchKind = SEARCH_STRUCTURES;
                 startSearch();
             }
+            if (hasCandidates) {
+                ImGui::SameLine();
+                if (ImGui::Button("Refine Candidates")) {
+                    searchKind = SEARCH_STRUCTURES;
+                    startSearch(true);
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Re-check only the seeds that passed the last search's query");
+                }
+            }
         } else {
             if (ImGui::Button("Stop Search")) {
                 stopSearch();
             }
         }
+        renderCandidateInfo();
+
+        renderSearchResults();
+    }
 
+    // Status, timing and found seeds of the current search, shared by all search tabs
+    void renderSearchResults() {
         // Search Progress and Results
         ImGui::Separator();
         ImGui::Text("Search Status:");
@@ -1194,6 +3429,15 @@ public:
             
             // Display total seeds checked
             ImGui::Text("Total Seeds Checked: %lld", seedsChecked.load());
+        } else if (searchComplete) {
+            std::string status;
+            {
+                std::lock_guard<std::mutex> lock(structuresMutex);
+                status = currentStatus;
+            }
+            ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), "Search Complete");
+            ImGui::TextWrapped("%s", status.c_str());
+            ImGui::Text("Total Seeds Checked: %lld", seedsChecked.load());
         } else if (seedsChecked > 0) {
             ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), "Search Stopped");
             ImGui::Text("Total Seeds Checked: %lld", seedsChecked.load());
@@ -1202,117 +3446,173 @@ public:
         ImGui::Separator();
 
         // Display found seeds in a table format
-        if (!foundSeeds.empty()) {
-            ImGui::Text("Found Seeds:");
-            
+        if (ranking) {
+            publishRanking();
+            double threshold = rankThreshold.load(std::memory_order_relaxed);
+            if (threshold != -INFINITY)
+                ImGui::Text("Ranking the best %zu seeds, cutoff score %.1f", rankK, threshold);
+            else
+                ImGui::Text("Ranking the best %zu seeds", rankK);
+        }
+        results.flushIfDue();
+        candidates.flushIfDue();
+        if (!results.healthy()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f),
+                               "⚠️ Cannot write %s, new results are only kept in memory", resultJournalPath);
+        }
+        if (!candidates.healthy() && searchKind == SEARCH_STRUCTURES) {
+            ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f),
+                               "⚠️ Cannot write %s, the candidates are only kept in memory", candidatePath);
+        }
+        size_t resultCount = results.size();
+        if (resultCount > 0) {
+            ImGui::Text("Found Seeds: %zu", resultCount);
+            ImGui::SameLine();
+            ImGui::PushItemWidth(200);
+            ImGui::InputTextWithHint("##resultfilter", "Filter seeds or structures", resultFilter, sizeof(resultFilter));
+            ImGui::PopItemWidth();
+
             // Align buttons to the right
             float windowWidth = ImGui::GetWindowWidth();
-            ImGui::SameLine(windowWidth - 200);
+            ImGui::SameLine(windowWidth - 240);
             if (ImGui::Button("Clear Seeds")) {
-                foundSeeds.clear();
-                structureNames.clear();
-                positions.clear();
+                std::lock_guard<std::mutex> lock(structuresMutex);
+                results.clear();
+                resultsVersion++;
+                resultIndex = ResultIndex();
+                ranked.clear();
+                rankedSeeds.clear();
+                rankChanged = false;
+                rankThreshold = -INFINITY;
             }
             
             ImGui::SameLine();
             if (ImGui::Button("Save Seeds")) {
                 saveSeedsToFile();
             }
+            ImGui::SameLine();
+            if (ImGui::Button("CSV")) {
+                saveSeedsToFile(true);
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Export the seeds as CSV");
+            }
 
             // Create a scrollable table for seeds
             ImGui::PushStyleColor(ImGuiCol_TableHeaderBg, ImGui::GetStyle().Colors[ImGuiCol_WindowBg]);
             ImGui::PushStyleColor(ImGuiCol_TableRowBg, ImGui::GetStyle().Colors[ImGuiCol_WindowBg]);
             ImGui::PushStyleColor(ImGuiCol_TableRowBgAlt, ImGui::GetStyle().Colors[ImGuiCol_WindowBg]);
 
-            if (ImGui::BeginTable("SeedsTable", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY | 
+            if (ImGui::BeginTable("SeedsTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY | 
                                                   ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable | 
-                                                  ImGuiTableFlags_Reorderable, ImVec2(0, 300))) {
+                                                  ImGuiTableFlags_Reorderable | ImGuiTableFlags_Sortable, ImVec2(0, 300))) {
                 
                 // Setup columns
-                ImGui::TableSetupColumn("No.", ImGuiTableColumnFlags_WidthFixed, 50.0f);
-                ImGui::TableSetupColumn("Seed", ImGuiTableColumnFlags_WidthStretch);
-                ImGui::TableSetupColumn("Structure", ImGuiTableColumnFlags_WidthStretch);
-                ImGui::TableSetupColumn("Coordinates", ImGuiTableColumnFlags_WidthStretch);
-                ImGui::TableSetupColumn("Actions", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableSetupColumn("No.", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_DefaultSort, 50.0f, RESULT_COL_NUMBER);
+                ImGui::TableSetupColumn("Seed", ImGuiTableColumnFlags_WidthStretch, 0.0f, RESULT_COL_SEED);
+                ImGui::TableSetupColumn("Structure", ImGuiTableColumnFlags_WidthStretch, 0.0f, RESULT_COL_NAME);
+                ImGui::TableSetupColumn("Coordinates", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort, 0.0f, RESULT_COL_COORDS);
+                ImGui::TableSetupColumn("Distance", ImGuiTableColumnFlags_WidthFixed, 70.0f, RESULT_COL_DISTANCE);
+                ImGui::TableSetupColumn("Actions", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort, 100.0f, RESULT_COL_ACTIONS);
                 ImGui::TableHeadersRow();
 
-                // Display seeds in rows
-                for (size_t i = 0; i < foundSeeds.size(); ++i) {
-                    ImGui::TableNextRow();
-                    
-                    // Number column
-                    ImGui::TableNextColumn();
-                    ImGui::Text("#%zu", i + 1);
+                if (ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs()) {
+                    if (specs->SpecsDirty && specs->SpecsCount > 0) {
+                        resultSortColumn = (int)specs->Specs[0].ColumnUserID;
+                        resultSortAscending = specs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+                        specs->SpecsDirty = false;
+                    }
+                }
 
-                    // Seed column
-                    ImGui::TableNextColumn();
-                    ImGui::Text("%lld", foundSeeds[i]);
+                // Search order needs no index, everything else is drawn from
+                // the background index, which may lag a few results behind
+                bool direct = resultSortColumn == RESULT_COL_NUMBER && resultFilter[0] == 0;
+                size_t rowCount = resultCount;
+                if (!direct) {
+                    updateResultIndex();
+                    std::lock_guard<std::mutex> lock(structuresMutex);
+                    rowCount = resultIndex.rows.size();
+                }
 
-                    // Structure and Coordinates columns
-                    ImGui::TableNextColumn();
-                    ImGui::TableNextColumn();
-                    if (i < structureNames.size() && i < positions.size()) {
-                        std::string structureInfo = structureNames[i];
-                        std::string coordsInfo;
+                ImGuiListClipper clipper;
+                clipper.Begin((int)rowCount);
+                std::vector<std::pair<size_t, SearchResult>> visible;
+                while (clipper.Step()) {
+                    visible.clear();
+                    {
+                        std::lock_guard<std::mutex> lock(structuresMutex);
+                        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                            size_t i;
+                            if (direct)
+                                i = resultSortAscending ? (size_t)row : resultCount - 1 - row;
+                            else if ((size_t)row < resultIndex.rows.size())
+                                i = resultIndex.rows[row];
+                            else
+                                continue;
+                            SearchResult r;
+                            if (results.get(i, &r)) visible.push_back({ i, r });
+                        }
+                    }
+
+                    for (const auto& v : visible) {
+                        size_t i = v.first;
+                        const SearchResult& r = v.second;
+                        ImGui::TableNextRow();
                         
-                        // Check if this is a multi-structure result
-                        size_t newlinePos = structureInfo.find('\n');
-                        if (newlinePos != std::string::npos) {
-                            // Multiple structures
-                            std::string baseStructure = structureInfo.substr(0, newlinePos);
-                            std::string attachedStructures = structureInfo.substr(newlinePos + 1);
-                            
-                            // Display base structure in Structure column
-                            ImGui::TableSetColumnIndex(2); // Go back to Structure column
-                            ImGui::Text("%s", baseStructure.c_str());
-                            
-                            // Display coordinates with structure names
-                            ImGui::TableSetColumnIndex(3); // Go to Coordinates column
-                            
-                            // First display base structure coordinates
-                            size_t bracketStart = baseStructure.find('[');
-                            size_t bracketEnd = baseStructure.find(']');
-                            if (bracketStart != std::string::npos && bracketEnd != std::string::npos) {
-                                std::string baseCoords = baseStructure.substr(bracketStart, bracketEnd - bracketStart + 1);
-                                ImGui::Text("Base Structure: %s", baseCoords.c_str());
-                            }
-                            
-                            // Then display attached structures' coordinates
-                            std::istringstream attachedStream(attachedStructures);
-                            std::string line;
-                            while (std::getline(attachedStream, line)) {
-                                if (!line.empty()) {
-                                    size_t nameEnd = line.find('[');
-                                    if (nameEnd != std::string::npos) {
-                                        std::string structName = line.substr(2, nameEnd - 3); // Remove "+ " prefix
-                                        std::string coords = line.substr(nameEnd);
-                                        coords = coords.substr(0, coords.find(" (Distance")); // Remove distance info
-                                        ImGui::Text("%s: %s", structName.c_str(), coords.c_str());
-                                    }
+                        // Number column
+                        ImGui::TableNextColumn();
+                        ImGui::Text("#%zu", i + 1);
+
+                        // Seed column
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%lld", (long long)r.seed);
+
+                        // Structure column, with the extra structures in a tooltip
+                        ImGui::TableNextColumn();
+                        std::string label = resultLabel(r);
+                        if (r.extraCount > 0) {
+                            ImGui::Text("%s (+%d)", label.c_str(), r.extraCount);
+                            if (ImGui::IsItemHovered()) {
+                                ImGui::BeginTooltip();
+                                for (int k = 0; k < r.extraCount; k++) {
+                                    const ResultExtra& e = r.extras[k];
+                                    ImGui::Text("%s: [X: %d, Z: %d]", extraLabel(e).c_str(), e.pos.x, e.pos.z);
                                 }
+                                ImGui::EndTooltip();
                             }
                         } else {
-                            // Single structure
-                            ImGui::TableSetColumnIndex(2); // Go back to Structure column
-                            ImGui::Text("%s", structureNames[i].c_str());
-                            
-                            ImGui::TableSetColumnIndex(3); // Go to Coordinates column
-                            ImGui::Text("[X: %d, Z: %d]", positions[i].x, positions[i].z);
+                            ImGui::TextUnformatted(label.c_str());
                         }
-                    }
 
-                    // Actions column
-                    ImGui::TableNextColumn();
-                    ImGui::PushID(static_cast<int>(i));
-                    if (ImGui::Button("Copy")) {
-                        char seedStr[32];
-                        snprintf(seedStr, sizeof(seedStr), "%lld", foundSeeds[i]);
-                        ImGui::SetClipboardText(seedStr);
-                    }
-                    if (ImGui::IsItemHovered()) {
-                        ImGui::SetTooltip("Copy seed to clipboard");
+                        // Coordinates and distance columns
+                        ImGui::TableNextColumn();
+                        ImGui::Text("[X: %d, Z: %d]", r.pos.x, r.pos.z);
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%dm", r.distance);
+
+                        // Actions column
+                        ImGui::TableNextColumn();
+                        ImGui::PushID(static_cast<int>(i));
+                        if (ImGui::Button("Copy")) {
+                            char seedStr[32];
+                            snprintf(seedStr, sizeof(seedStr), "%lld", (long long)r.seed);
+                            ImGui::SetClipboardText(seedStr);
+                        }
+                        if (ImGui::IsItemHovered()) {
+                            ImGui::SetTooltip("Copy seed to clipboard");
+                        }
+                        ImGui::SameLine();
+                        if (ImGui::Button("Map")) {
+                            seedMap.show(r.seed, resultVersion(r), r.pos, resultMarkers(r));
+                            mapSeedInput = r.seed;
+                            selectMapTab = true;
+                        }
+                        if (ImGui::IsItemHovered()) {
+                            ImGui::SetTooltip("Show the seed's biomes around this result");
+                        }
+                        ImGui::PopID();
                     }
-                    ImGui::PopID();
                 }
                 
                 ImGui::EndTable();
@@ -1322,6 +3622,94 @@ public:
         }
     }
 
+    // Starts a background rebuild of the results index when it is out of
+    // date, at most every quarter second while results keep coming in
+    void updateResultIndex() {
+        {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            bool stale = resultIndex.sortColumn != resultSortColumn ||
+                         resultIndex.ascending != resultSortAscending ||
+                         resultIndex.filter != resultFilter;
+            bool grown = resultIndex.covered != results.size() || resultIndex.version != resultsVersion;
+            if (!stale && !grown) return;
+            if (!stale && std::chrono::steady_clock::now() - indexStartedAt < std::chrono::milliseconds(250))
+                return;
+        }
+        if (indexBusy) return;
+        if (indexThread.joinable()) indexThread.join();
+
+        indexBusy = true;
+        indexStartedAt = std::chrono::steady_clock::now();
+        indexThread = std::thread(&StructureFinder::buildResultIndex, this,
+                                  resultSortColumn, resultSortAscending, std::string(resultFilter));
+    }
+
+    void buildResultIndex(int column, bool ascending, std::string filter) {
+        struct Row {
+            uint32_t index;
+            int64_t seed;
+            int distance;
+            std::string label;
+        };
+        // Labels are only needed for filtering and sorting by structure
+        bool needLabels = !filter.empty() || column == RESULT_COL_NAME;
+        // Records are paged in from the journal one at a time
+        uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            version = resultsVersion;
+        }
+        size_t covered = results.size();
+        std::vector<Row> rows;
+        rows.reserve(covered);
+        SearchResult rec;
+        for (size_t i = 0; i < covered && results.get(i, &rec); i++) {
+            rows.push_back({ (uint32_t)i, rec.seed, rec.distance, std::string() });
+            if (!needLabels) continue;
+            std::string& l = rows.back().label;
+            l = resultLabel(rec);
+            for (int k = 0; k < rec.extraCount; k++)
+                l += "\n" + extraLabel(rec.extras[k]);
+        }
+
+        if (!filter.empty()) {
+            std::string f = filter;
+            std::transform(f.begin(), f.end(), f.begin(), ::tolower);
+            rows.erase(std::remove_if(rows.begin(), rows.end(), [&f](Row& r) {
+                std::string text = std::to_string(r.seed) + "\n" + r.label;
+                std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+                return text.find(f) == std::string::npos;
+            }), rows.end());
+        }
+
+        auto less = [column](const Row& a, const Row& b) {
+            switch (column) {
+            case RESULT_COL_SEED:     return a.seed < b.seed;
+            case RESULT_COL_NAME:     return a.label < b.label;
+            case RESULT_COL_DISTANCE: return a.distance < b.distance;
+            default:                  return a.index < b.index;
+            }
+        };
+        if (ascending)
+            std::stable_sort(rows.begin(), rows.end(), less);
+        else
+            std::stable_sort(rows.begin(), rows.end(), [&less](const Row& a, const Row& b) { return less(b, a); });
+
+        ResultIndex index;
+        index.rows.reserve(rows.size());
+        for (const Row& r : rows) index.rows.push_back(r.index);
+        index.sortColumn = column;
+        index.ascending = ascending;
+        index.filter = filter;
+        index.covered = covered;
+        index.version = version;
+        {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            resultIndex = std::move(index);
+        }
+        indexBusy = false;
+    }
+
     void renderSettingsTab() {
         if (ImGui::BeginTabItem("Settings")) {
             // Performance Settings Category
@@ -1343,6 +3731,17 @@ public:
                     generatorPoolSize = appSettings.generatorPoolSize;
                     appSettings.saveToFile("settings.ini");
                 }
+
+                // Seed map cache
+                if (ImGui::SliderInt("Map Cache (MB)", &appSettings.mapCacheMB, 16, 4096, "%d", ImGuiSliderFlags_Logarithmic)) {
+                    seedMap.tileCache().setBudget((size_t)appSettings.mapCacheMB << 20);
+                    appSettings.saveToFile("settings.ini");
+                }
+                MapCache::Stats cs = seedMap.tileCache().stats();
+                uint64_t lookups = cs.hits + cs.misses;
+                ImGui::Text("Map cache: %.1f / %.0f MB in %zu entries, %.1f%% hit rate",
+                            cs.bytes / 1048576.0, cs.budget / 1048576.0, cs.entries,
+                            lookups ? 100.0 * cs.hits / lookups : 0.0);
             }
 
             // UI Settings Category
@@ -1434,7 +3833,58 @@ public:
         }
     }
 
+    // Map markers of a result: its position and every overworld extra
+    std::vector<SeedMapViewer::Marker> resultMarkers(const SearchResult& r) {
+        std::vector<SeedMapViewer::Marker> out;
+        out.push_back({ resultLabel(r), r.pos });
+        for (int k = 0; k < r.extraCount; k++) {
+            const ResultExtra& e = r.extras[k];
+            if (e.dim == EXTRA_ATTACHED || e.dim == DIMQ_OVERWORLD)
+                out.push_back({ extraLabel(e), e.pos });
+        }
+        return out;
+    }
+
+    void renderMapTab() {
+        ImGui::Text("Seed:");
+        ImGui::SameLine();
+        ImGui::PushItemWidth(200);
+        ImGui::InputScalar("##mapseed", ImGuiDataType_S64, &mapSeedInput);
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        if (ImGui::Button("Show")) {
+            Pos origin = { 0, 0 };
+            seedMap.show(mapSeedInput, mcVersion, origin, {});
+        }
+        ImGui::SameLine();
+        ImGui::TextDisabled("(?)");
+        if (ImGui::IsItemHovered()) {
+            ImGui::BeginTooltip();
+            ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+            ImGui::TextUnformatted("Overworld biomes of a seed. Use the Map button of a search result to open it "
+                                   "with its structures marked. Drag to pan and scroll to zoom; the map is "
+                                   "generated in the background, coarse areas first.");
+            ImGui::PopTextWrapPos();
+            ImGui::EndTooltip();
+        }
+        if (seedMap.hasSeed()) {
+            ImGui::SameLine();
+            ImGui::Text("Seed %lld, %.2f blocks per pixel", (long long)seedMap.currentSeed(), seedMap.zoom());
+        }
+
+        ImVec2 size = ImGui::GetContentRegionAvail();
+        size.x = std::max(size.x, 64.0f);
+        size.y = std::max(size.y, 64.0f);
+        seedMap.render(size);
+    }
+
     void renderGUI() {
+        // A finished scan keeps the status its last worker reported
+        if (isSearching && scanFinished()) {
+            endSearch();
+            searchComplete = !shouldStop;
+        }
+
         ImGui::Begin("ChunkBiomes GUI", nullptr, ImGuiWindowFlags_NoCollapse);
 
         if (ImGui::BeginTabBar("MainTabs")) {
@@ -1459,132 +3909,633 @@ public:
                 ImGui::EndTabItem();
             }
 
-            // About Tab
-            if (ImGui::BeginTabItem("About")) {
-                renderAboutTab();
-                ImGui::EndTabItem();
+            // End City Tab
+            if (ImGui::BeginTabItem("End City Finder")) {
+                renderEndCityTab();
+                ImGui::EndTabItem();
+            }
+
+            // Quad Tab
+            if (ImGui::BeginTabItem("Quad Finder")) {
+                renderQuadTab();
+                ImGui::EndTabItem();
+            }
+
+            // Proximity Bitmap Tab
+            if (ImGui::BeginTabItem("Bitmaps")) {
+                renderBitmapTab();
+                ImGui::EndTabItem();
+            }
+
+            // Slime Chunk Tab
+            if (ImGui::BeginTabItem("Slime Chunks")) {
+                renderSlimeTab();
+                ImGui::EndTabItem();
+            }
+
+            // Seed Map Tab
+            if (ImGui::BeginTabItem("Seed Map", nullptr, selectMapTab ? ImGuiTabItemFlags_SetSelected : 0)) {
+                renderMapTab();
+                ImGui::EndTabItem();
+            }
+            selectMapTab = false;
+
+            // About Tab
+            if (ImGui::BeginTabItem("About")) {
+                renderAboutTab();
+                ImGui::EndTabItem();
+            }
+
+            ImGui::EndTabBar();
+        }
+
+        ImGui::End();
+    }
+
+    bool isDeepOcean(int biomeId) {
+        return biomeId == deep_ocean ||
+               biomeId == deep_frozen_ocean ||
+               biomeId == deep_cold_ocean ||
+               biomeId == deep_lukewarm_ocean;
+    }
+
+    bool isShipwreckBiome(int biomeId) {
+       return biomeId == beach ||
+           biomeId == snowy_beach ||
+           biomeId == ocean ||
+           biomeId == frozen_ocean ||
+           biomeId == deep_frozen_ocean ||
+           biomeId == cold_ocean ||
+           biomeId == deep_cold_ocean ||
+           biomeId == lukewarm_ocean ||
+           biomeId == deep_lukewarm_ocean ||
+           biomeId == warm_ocean;
+    }
+
+    bool isVillageBiome(int biomeId) {
+        return biomeId == desert ||
+               biomeId == plains ||
+               biomeId == meadow ||
+               biomeId == savanna ||
+               biomeId == snowy_plains ||
+               biomeId == taiga ||
+               biomeId == snowy_taiga ||
+               biomeId == sunflower_plains;
+    }
+
+    // Biome whitelist of the structure types that are checked after generation
+    bool isStructureBiome(int structureType, int biomeId) {
+        switch (structureType) {
+            case Monument:  return isDeepOcean(biomeId);
+            case Mansion:   return biomeId == dark_forest;
+            case Shipwreck: return isShipwreckBiome(biomeId);
+            case Village:   return isVillageBiome(biomeId);
+            default:        return true;
+        }
+    }
+
+    void resetSearchMetrics() {
+        seedsChecked = 0;
+        searchStartTime = std::chrono::steady_clock::now();
+        lastCalculatedSeedsPerSecond = 0.0;
+    }
+
+    double calculateSeedsPerSecond() {
+        auto now = std::chrono::steady_clock::now();
+        auto endTime = isSearching ? now : std::chrono::steady_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - searchStartTime).count();
+        
+        if (duration > 0) {
+            lastCalculatedSeedsPerSecond = seedsChecked * 1000.0 / duration;
+        }
+        
+        return lastCalculatedSeedsPerSecond;
+    }
+
+    bool isWithinRadius(const Pos& pos, int radius) {
+        return (int)sqrt(pow(pos.x, 2) + pow(pos.z, 2)) <= radius;
+    }
+
+    struct CoverageSample {
+        StructureFinder* finder;
+        SeedContext* ctx;
+        int x4, z4, r4;
+        int biomeId;
+    };
+
+    static int coverageEval(Generator*, int, int x, int y, int z, void* data) {
+        CoverageSample* cs = (CoverageSample*) data;
+        int dx = x - cs->x4, dz = z - cs->z4;
+        if (dx*dx + dz*dz > cs->r4*cs->r4)
+            return -1;  // outside the circle, skip
+        return cs->finder->biomeAt4(*cs->ctx, x, y, z) == cs->biomeId;
+    }
+
+    // Checks that at least sb.coverage of the 1:4 cells within sb.radius blocks
+    // of the center are sb.biomeId. Small areas are generated with genBiomes()
+    // in strips of rows, stopping as soon as the outcome is certain. Large areas
+    // are estimated with monteCarloBiomes() at 95% confidence instead.
+    bool checkSurroundingBiomes(SeedContext& ctx, int centerX, int centerZ, const SurroundingBiome& sb) {
+        const int stripRows = 4;
+        const int y4 = 319 >> 2;
+        int x4 = centerX >> 2, z4 = centerZ >> 2;
+        int r4 = sb.radius >> 2;
+
+        // Layered versions first rule out areas the biome cannot reach at all
+        if (ctx.g.mc <= MC_1_17 && sb.coverage > 0) {
+            if (!isOverworld(ctx.g.mc, sb.biomeId)) return false;
+            BiomeFilter filter;
+            setupBiomeFilter(&filter, ctx.g.mc, 0, &sb.biomeId, 1, NULL, 0, NULL, 0);
+            if (!layersMayContain(ctx, ctx.seed, filter, x4 - r4, z4 - r4, 2*r4 + 1, 2*r4 + 1))
+                return false;
+        }
+
+        int64_t total = 0;
+        for (int dz = -r4; dz <= r4; dz++) {
+            total += 2 * (int)sqrt((double)(r4*r4 - dz*dz)) + 1;
+        }
+
+        if (total > coverageExactCells) {
+            CoverageSample cs = { this, &ctx, x4, z4, r4, sb.biomeId };
+            Range r = { 4, x4 - r4, z4 - r4, 2*r4 + 1, 2*r4 + 1, y4, 1 };
+            uint64_t rng;
+            setSeed(&rng, (uint64_t)ctx.seed ^ ((uint64_t)(uint32_t)centerX << 32) ^ (uint32_t)centerZ);
+            return monteCarloBiomes(&ctx.g, r, &rng, sb.coverage, 0.95, coverageEval, &cs) != 0;
+        }
+
+        int64_t need = (int64_t)ceil(sb.coverage * total);
+        int64_t seen = 0, match = 0;
+
+        for (int dz0 = -r4; dz0 <= r4; dz0 += stripRows) {
+            int rows = std::min(stripRows, r4 - dz0 + 1);
+            // the widest row of the strip is the one closest to the center
+            int dzn = (dz0 <= 0 && dz0 + rows > 0) ? 0 : std::min(abs(dz0), abs(dz0 + rows - 1));
+            int wmax = (int)sqrt((double)(r4*r4 - dzn*dzn));
+
+            Range r = { 4, x4 - wmax, z4 + dz0, 2*wmax + 1, rows, y4, 1 };
+            size_t siz = getMinCacheSize(&ctx.g, 4, r.sx, 1, r.sz);
+            if (ctx.area.size() < siz)
+                ctx.area.resize(siz);
+            if (genBiomes(&ctx.g, ctx.area.data(), r))
+                return false;
+
+            for (int j = 0; j < rows; j++) {
+                int dz = dz0 + j;
+                int w = (int)sqrt((double)(r4*r4 - dz*dz));
+                const int* row = ctx.area.data() + (size_t)j * r.sx + (wmax - w);
+                for (int i = 0; i <= 2*w; i++) {
+                    match += row[i] == sb.biomeId;
+                }
+                seen += 2*w + 1;
+
+                if (match >= need) return true;
+                if (match + (total - seen) < need) return false;
+            }
+        }
+        return match >= need;
+    }
+
+    // Largest offset, in 1:4 cells, that the shift noise can apply to the
+    // climate sampling position (see sampleBiomeNoise)
+    static int shiftMargin(const BiomeNoise& bn) {
+        const DoublePerlinNoise& shift = bn.climate[NP_SHIFT];
+        double amp = 0;
+        for (int i = 0; i < shift.octA.octcnt; i++) amp += fabs(shift.octA.octaves[i].amplitude);
+        for (int i = 0; i < shift.octB.octcnt; i++) amp += fabs(shift.octB.octaves[i].amplitude);
+        // perlin noise stays below ~1.0363 in magnitude
+        return (int)ceil(4.0 * 1.04 * amp * fabs(shift.amplitude));
+    }
+
+    // Bounds the climate of a square tile at 1:4, widened by the shift margin,
+    // with getParaRange(). The shifted sampling positions fall between the
+    // integer ones, so the ranges are widened by 'slack' from getParaRangeSlack().
+    // Returns false if the biome with parameter limits 'lim' cannot generate in
+    // the tile. Otherwise 'overlap' is set to the smallest fraction of a
+    // parameter range that lies within the limits.
+    bool biomeTileMayContain(Generator& g, const int* lim, const double* slack, int x4, int z4, int size,
+                             int margin, double* overlap) {
+        static const int order[] = { NP_CONTINENTALNESS, NP_TEMPERATURE, NP_HUMIDITY, NP_EROSION, NP_WEIRDNESS };
+        const int* ext = getBiomeParaExtremes(g.mc);
+        *overlap = 1.0;
+        for (int np : order) {
+            if (lim[2*np+0] <= ext[2*np+0] && lim[2*np+1] >= ext[2*np+1])
+                continue;  // not constrained
+            double pmin, pmax;
+            if (getParaRange(&g.bn.climate[np], &pmin, &pmax, x4 - margin, z4 - margin,
+                             size + 2*margin, size + 2*margin, NULL, NULL)) {
+                continue;
+            }
+            // and one unit for the integer truncation of the parameters
+            pmin -= slack[np] + 1;
+            pmax += slack[np] + 1;
+            if (pmax < lim[2*np+0] || pmin > lim[2*np+1])
+                return false;
+            double inside = std::min(pmax, (double)lim[2*np+1]) - std::max(pmin, (double)lim[2*np+0]);
+            *overlap = std::min(*overlap, inside / (pmax - pmin + 1e-9));
+        }
+        return true;
+    }
+
+    // Layered counterpart of biomeTileMayContain() for versions up to 1.17.
+    // Generates the 1:64 cells covering the 1:4 area (x4, z4, w, h), widened
+    // for the zooms below, with the layer filters of 'filter' swapped in, so
+    // generation stops at the coarsest layer that rules the biomes out. The
+    // biomes themselves are not required at 1:64, as shores, rivers and ocean
+    // temperatures only appear further down the stack.
+    bool layersMayContain(SeedContext& ctx, int64_t seed, const BiomeFilter& filter,
+                          int x4, int z4, int w, int h) {
+        const int pad = 2;
+        BiomeFilter bf = filter;
+        bf.biomeToFind = bf.biomeToFindM = 0;
+
+        Layer* entry = ctx.g.ls.entry_64;
+        int x = (x4 >> 4) - pad, z = (z4 >> 4) - pad;
+        int sx = ((x4 + w - 1) >> 4) + pad - x + 1;
+        int sz = ((z4 + h - 1) >> 4) + pad - z + 1;
+        size_t siz = getMinLayerCacheSize(entry, sx, sz);
+        if (ctx.area.size() < siz)
+            ctx.area.resize(siz);
+        int ok = checkForBiomesAtLayer(&ctx.g.ls, entry, ctx.area.data(), seed, x, z, sx, sz, &bf);
+        // the layers above 1:64 now hold this seed, the ones below may not
+        if (ctx.seed != seed) ctx.seeded = false;
+        return ok != 0;
+    }
+
+    static bool tileInCircle(int x, int z, int size, int radius) {
+        // distance from the center to the nearest point of the tile (in blocks,
+        // relative to the center)
+        int64_t dx = x > 0 ? x : (x + size < 0 ? -(x + size) : 0);
+        int64_t dz = z > 0 ? z : (z + size < 0 ? -(z + size) : 0);
+        return dx*dx + dz*dz <= (int64_t)radius*radius;
+    }
+
+    // Locates the biome query for a seed, coarse to fine: 256-block tiles are
+    // pruned on their climate ranges, 64-block subtiles are pruned again when
+    // their parent barely overlapped the biome's limits, and the remaining
+    // subtiles are generated at 1:4. Tiles are only pruned when their widened
+    // climate bounds rule the biome out (see testBiomeTilePruning() in the
+    // cubiomes tests), so pruning does not change the nearest position or the
+    // coverage of the circle. The circle is centered on the origin, or on the
+    // world spawn with biomeQuery.fromSpawn.
+    bool findBiome(int64_t seed, Pos* pos, double* coverage) {
+        const int tileCells = 64, subCells = 16;  // 1:256 and 1:64 tiles in 1:4 cells
+        // refine the 1:64 climate ranges only below this overlap, otherwise
+        // most subtiles survive and generating them is cheaper
+        const double refineOverlap = 0.25;
+
+        SeedContext& ctx = threadContext();
+        const int r = biomeQuery.radius;
+        const int biome = biomeQuery.biomeId;
+        const int y4 = 319 >> 2;
+        if (!isOverworld(ctx.g.mc, biome)) return false;
+
+        Pos c = { 0, 0 };
+        if (biomeQuery.fromSpawn) c = worldSpawn(ctx, seed);
+        // 1:4 cells that can have their center within the circle
+        const int x4lo = (c.x - r) >> 2, x4hi = (c.x + r) >> 2;
+        const int z4lo = (c.z - r) >> 2, z4hi = (c.z + r) >> 2;
+
+        // Up to 1.17 the tiles are pruned at the coarse layers instead, and the
+        // whole circle is checked before the seed is applied to the full stack
+        const bool layered = ctx.g.mc <= MC_1_17;
+        BiomeFilter filter;
+        if (layered) {
+            setupBiomeFilter(&filter, ctx.g.mc, 0, &biome, 1, NULL, 0, NULL, 0);
+            if (!layersMayContain(ctx, seed, filter, x4lo, z4lo, x4hi - x4lo + 1, z4hi - z4lo + 1))
+                return false;
+        }
+
+        Generator& g = seedGenerator(ctx, seed);
+        const int* lim = layered ? NULL : getBiomeParaLimits(g.mc, biome);
+        const int margin = layered ? 0 : shiftMargin(g.bn);
+        double slack[NP_MAX] = {};
+        if (!layered) {
+            for (int np = 0; np < NP_MAX; np++) {
+                if (np != NP_SHIFT) slack[np] = getParaRangeSlack(&g.bn.climate[np]);
+            }
+        }
+
+        // 1:4 cells within the circle, by the block at the center of the cell
+        int64_t total = 0;
+        for (int z4 = z4lo; z4 <= z4hi; z4++) {
+            for (int x4 = x4lo; x4 <= x4hi; x4++) {
+                int64_t bx = x4*4 + 2 - c.x, bz = z4*4 + 2 - c.z;
+                total += bx*bx + bz*bz <= (int64_t)r*r;
+            }
+        }
+        int64_t need = std::max<int64_t>(1, (int64_t)ceil(biomeQuery.minCoverage * total));
+
+        struct Tile { int x4, z4; double overlap; };
+        std::vector<Tile> tiles;
+        for (int tz = (c.z - r) >> 8; tz <= (c.z + r) >> 8; tz++) {
+            for (int tx = (c.x - r) >> 8; tx <= (c.x + r) >> 8; tx++) {
+                if (!tileInCircle(tx*256 - c.x, tz*256 - c.z, 256, r)) continue;
+                Tile t = { tx*tileCells, tz*tileCells, 1.0 };
+                if (lim && !biomeTileMayContain(g, lim, slack, t.x4, t.z4, tileCells, margin, &t.overlap))
+                    continue;
+                if (layered && !layersMayContain(ctx, seed, filter, t.x4, t.z4, tileCells, tileCells))
+                    continue;
+                tiles.push_back(t);
+            }
+            if (shouldStop) return false;
+        }
+
+        int64_t remaining = (int64_t)tiles.size() * tileCells * tileCells;
+        int64_t match = 0, bestDistSq = INT64_MAX;
+
+        for (const Tile& t : tiles) {
+            bool refine = (lim && t.overlap < refineOverlap) || layered;
+            for (int sz = 0; sz < tileCells; sz += subCells) {
+                for (int sx = 0; sx < tileCells; sx += subCells) {
+                    remaining -= subCells * subCells;
+                    int x4 = t.x4 + sx, z4 = t.z4 + sz;
+                    if (!tileInCircle(x4*4 - c.x, z4*4 - c.z, subCells*4, r)) continue;
+                    double overlap;
+                    if (refine && lim && !biomeTileMayContain(g, lim, slack, x4, z4, subCells, margin, &overlap))
+                        continue;
+                    if (refine && layered && !layersMayContain(ctx, seed, filter, x4, z4, subCells, subCells))
+                        continue;
+
+                    Range rg = { 4, x4, z4, subCells, subCells, y4, 1 };
+                    size_t siz = getMinCacheSize(&g, 4, rg.sx, 1, rg.sz);
+                    if (ctx.area.size() < siz)
+                        ctx.area.resize(siz);
+                    if (genBiomes(&g, ctx.area.data(), rg))
+                        return false;
+
+                    for (int j = 0; j < subCells; j++) {
+                        for (int i = 0; i < subCells; i++) {
+                            if (ctx.area[j*subCells + i] != biome) continue;
+                            int64_t bx = (x4 + i)*4 + 2, bz = (z4 + j)*4 + 2;
+                            int64_t distSq = (bx - c.x)*(bx - c.x) + (bz - c.z)*(bz - c.z);
+                            if (distSq > (int64_t)r*r) continue;
+                            match++;
+                            if (distSq < bestDistSq) {
+                                bestDistSq = distSq;
+                                pos->x = (int)bx;
+                                pos->z = (int)bz;
+                            }
+                        }
+                    }
+                    // stop once the required coverage is out of reach
+                    if (match + remaining < need) return false;
+                }
+            }
+            if (shouldStop) return false;
+        }
+
+        *coverage = total > 0 ? (double)match / total : 0.0;
+        if (match < need) return false;
+
+        if (biomeQuery.areaEnabled) {
+            Pos p0, p1;
+            if (!findBiomeSquare(ctx, biome, c, r, biomeQuery.areaSize, &p0, &p1))
+                return false;
+            pos->x = (p0.x + p1.x) / 2;
+            pos->z = (p0.z + p1.z) / 2;
+        }
+        return true;
+    }
+
+    // Looks for a square of at least 'side' blocks of a biome inside the
+    // square of radius 'r' around 'c'. The area is generated at 1:4 in
+    // strips of rows, keeping only a column histogram of how many rows each
+    // column has been the biome, so memory is O(width). A square is found when
+    // enough neighbouring columns reach the side length, and the search stops
+    // as soon as the remaining rows cannot complete one. The corners of the
+    // square are written to p0 and p1 (inclusive, in blocks).
+    bool findBiomeSquare(SeedContext& ctx, int biome, Pos c, int r, int side, Pos* p0, Pos* p1) {
+        static thread_local std::vector<int> heights;
+        const int stripRows = 4;
+        const int y4 = 319 >> 2;
+        int x0 = (c.x >> 2) - (r >> 2), z0 = (c.z >> 2) - (r >> 2);
+        int n = 2 * (r >> 2) + 1;
+        int side4 = (side + 3) >> 2;
+        if (side4 > n) return false;
+
+        heights.assign(n, 0);
+
+        for (int j0 = 0; j0 < n; j0 += stripRows) {
+            if (shouldStop) return false;
+
+            int rows = std::min(stripRows, n - j0);
+            Range rg = { 4, x0, z0 + j0, n, rows, y4, 1 };
+            size_t siz = getMinCacheSize(&ctx.g, 4, rg.sx, 1, rg.sz);
+            if (ctx.area.size() < siz)
+                ctx.area.resize(siz);
+            if (genBiomes(&ctx.g, ctx.area.data(), rg))
+                return false;
+
+            for (int k = 0; k < rows; k++) {
+                int j = j0 + k;
+                const int* row = ctx.area.data() + (size_t)k * n;
+                int run = 0;
+                for (int i = 0; i < n; i++) {
+                    heights[i] = row[i] == biome ? heights[i] + 1 : 0;
+                    run = heights[i] >= side4 ? run + 1 : 0;
+                    if (run >= side4) {
+                        p0->x = (x0 + i - side4 + 1) * 4;
+                        p0->z = (z0 + j - side4 + 1) * 4;
+                        p1->x = (x0 + i + 1) * 4 - 1;
+                        p1->z = (z0 + j + 1) * 4 - 1;
+                        return true;
+                    }
+                }
+
+                // With fewer rows left than the side length, only columns
+                // that are already part of the biome can still finish one
+                int left = n - 1 - j;
+                if (left < side4) {
+                    run = 0;
+                    for (int i = 0; i < n && run < side4; i++) {
+                        run = heights[i] + left >= side4 ? run + 1 : 0;
+                    }
+                    if (run < side4) return false;
+                }
             }
+        }
+        return false;
+    }
 
-            ImGui::EndTabBar();
+    // Checks the ravine query for a seed. The nearest matching ravine is
+    // stored in 'pos' and the number of matching ravines in 'count'.
+    bool findRavines(int64_t seed, Pos* pos, int* count) {
+        static thread_local std::vector<StructureVariant> ravines;
+
+        int32_t seed32 = (int32_t)(seed & 0xFFFFFFFF);
+        BedrockSeedCalls sc;
+        initBedrockSeedCalls(&sc, seed32);
+
+        // A ravine starts somewhere inside its chunk
+        int r = ravineQuery.radius;
+        int rc = (r >> 4) + 1;
+        int n = getBedrockRavinesInArea(&sc, -rc, -rc, rc, rc,
+                                        ravines.data(), (int)ravines.size());
+        if (n > (int)ravines.size()) {
+            // the buffer was too small, scan again with enough room
+            ravines.resize(n);
+            n = getBedrockRavinesInArea(&sc, -rc, -rc, rc, rc, ravines.data(), n);
+        }
+        if (n < ravineQuery.minCount) return false;
+
+        int matches = 0;
+        int64_t bestDistSq = INT64_MAX;
+        for (int i = 0; i < n; i++) {
+            const StructureVariant& rv = ravines[i];
+            if (ravineQuery.giantOnly && !rv.giant) continue;
+            int64_t distSq = (int64_t)rv.x*rv.x + (int64_t)rv.z*rv.z;
+            if (distSq > (int64_t)r*r) continue;
+            matches++;
+            if (distSq < bestDistSq) {
+                bestDistSq = distSq;
+                pos->x = rv.x;
+                pos->z = rv.z;
+            }
         }
 
-        ImGui::End();
+        *count = matches;
+        return matches >= ravineQuery.minCount;
     }
 
-    bool isDeepOcean(int biomeId) {
-        return biomeId == deep_ocean ||
-               biomeId == deep_frozen_ocean ||
-               biomeId == deep_cold_ocean ||
-               biomeId == deep_lukewarm_ocean;
-    }
+    // Biome, terrain and optionally ship check of an End city position
+    bool isEndCityViable(SeedContext& ctx, int64_t seed, Pos p, bool needShip) {
+        static thread_local std::vector<Piece> pieces(END_CITY_PIECES_MAX);
 
-    bool isShipwreckBiome(int biomeId) {
-       return biomeId == beach ||
-           biomeId == snowy_beach ||
-           biomeId == ocean ||
-           biomeId == frozen_ocean ||
-           biomeId == deep_frozen_ocean ||
-           biomeId == cold_ocean ||
-           biomeId == deep_cold_ocean ||
-           biomeId == lukewarm_ocean ||
-           biomeId == deep_lukewarm_ocean ||
-           biomeId == warm_ocean;
-    }
+        // Midlands or highlands, i.e. outside the main island biome and with
+        // a height noise of at least 0. Islands further than 6 cells cannot
+        // raise it that high.
+        int cx = p.x >> 4, cz = p.z >> 4;
+        if (cx*cx + cz*cz <= 4096) return false;
+        Generator& eg = seedEnd(ctx, seed);
+        if (getEndHeightNoise(&eg.en, 2*cx + 1, 2*cz + 1, 6) < 0) return false;
 
-    bool isVillageBiome(int biomeId) {
-        return biomeId == desert ||
-               biomeId == plains ||
-               biomeId == meadow ||
-               biomeId == savanna ||
-               biomeId == snowy_plains ||
-               biomeId == taiga ||
-               biomeId == snowy_taiga ||
-               biomeId == sunflower_plains;
-    }
+        if (!isViableEndCityTerrain(&eg, &endSurface(ctx), p.x, p.z)) return false;
 
-    void resetSearchMetrics() {
-        seedsChecked = 0;
-        foundSeeds.clear();
-        searchStartTime = std::chrono::steady_clock::now();
-        lastCalculatedSeedsPerSecond = 0.0;
+        if (needShip) {
+            int n = getEndCityPieces(pieces.data(), seed, cx, cz);
+            for (int i = 0; i < n; i++) {
+                if (pieces[i].type == END_SHIP) return true;
+            }
+            return false;
+        }
+        return true;
     }
 
-    double calculateSeedsPerSecond() {
-        auto now = std::chrono::steady_clock::now();
-        auto endTime = isSearching ? now : std::chrono::steady_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - searchStartTime).count();
-        
-        if (duration > 0) {
-            lastCalculatedSeedsPerSecond = seedsChecked * 1000.0 / duration;
+    // Full check of an overworld structure position, cheapest tiers first
+    bool isOverworldStructureViable(SeedContext& ctx, int64_t seed, int structureType, Pos p) {
+        // Climate parameters of the biome whitelist, before the full seeding
+        if (climateRejectsBiome(ctx, seed, structureType, p)) return false;
+
+        // Reuses the generator and biome hint of earlier checks for this seed
+        Generator& g = seedGenerator(ctx, seed);
+
+        // Cheap climate bound before the full biome checks
+        if (approxRejectsBiome(ctx, structureType, p)) return false;
+
+        if (!isViableStructurePos(structureType, &g, p.x, p.z, 0)) return false;
+
+        bool skipTerrainCheck = (structureType == Ancient_City ||
+                                 structureType == Monument);
+        if (!skipTerrainCheck && !isViableStructureTerrain(structureType, &g, p.x, p.z)) {
+            return false;
         }
-        
-        return lastCalculatedSeedsPerSecond;
+
+        int biomeId = biomeAt4(ctx, p.x >> 2, 319>>2, p.z >> 2);
+        if (biomeId == none) return false;
+        return isStructureBiome(structureType, biomeId);
     }
 
-    bool isWithinRadius(const Pos& pos, int radius) {
-        return (int)sqrt(pow(pos.x, 2) + pow(pos.z, 2)) <= radius;
+    // Full check of a structure position in the structure's own dimension.
+    // Only the noise of that dimension gets seeded.
+    bool isViableStructure(SeedContext& ctx, int64_t seed, int structureType, Pos p) {
+        if (isNetherStructure(structureType))
+            return checkNetherStructure(ctx, seed, structureType, p);
+        if (structureType == End_City)
+            return isEndCityViable(ctx, seed, p, false);
+        return isOverworldStructureViable(ctx, seed, structureType, p);
     }
 
-    bool checkSurroundingBiomes(int centerX, int centerZ, int biomeId, int radius, Generator& g) {
-        int count = 0;
-        int total = 0;
-        const float threshold = 0.9f;
-        const int step = 8; // Check every 8 blocks for speed
-        const int radiusSquared = radius * radius;
-        
-        // Quick cardinal check first
-        const int cardinals[4][2] = {{0,radius}, {radius,0}, {0,-radius}, {-radius,0}};
-        for(int i = 0; i < 4; i++) {
-            if(getBiomeAt(&g, 4, (centerX + cardinals[i][0]) >> 2, 319>>2, (centerZ + cardinals[i][1]) >> 2) != biomeId) {
-                return false; // Fail fast if cardinal points don't match
+    // Nearest viable structure within 'radius' of the origin of its dimension,
+    // or of world spawn if 'fromSpawn' is set
+    bool findStructureNearOrigin(SeedContext& ctx, int64_t seed, int structureType, int radius, bool fromSpawn, Pos* pos) {
+        StructureConfig sconf;
+        if (!getBedrockStructureConfig(structureType, ctx.g.mc, &sconf)) return false;
+
+        int32_t seed32 = (int32_t)(seed & 0xFFFFFFFF);
+        int reach = fromSpawn ? spawnMaxReach(ctx.g.mc) : 0;
+        int regionRadius = (radius + reach) / (sconf.regionSize * 16) + 1;
+        int64_t bestDistSq = INT64_MAX;
+
+        for (int regionX = -regionRadius; regionX <= regionRadius; ++regionX) {
+            for (int regionZ = -regionRadius; regionZ <= regionRadius; ++regionZ) {
+                if (shouldStop) return false;
+
+                Pos p;
+                if (!getBedrockStructurePos(structureType, ctx.g.mc, seed32, regionX, regionZ, &p)) {
+                    continue;
+                }
+                int64_t distSq = (int64_t)p.x*p.x + (int64_t)p.z*p.z;
+                int64_t maxDist = (int64_t)radius + reach;
+                if (distSq > maxDist*maxDist) continue;
+                if (fromSpawn) {
+                    int dist;
+                    if (!withinSpawnDistance(ctx, seed, p, 0, radius, &dist)) continue;
+                    distSq = (int64_t)dist*dist;
+                }
+                if (distSq >= bestDistSq) continue;
+                if (!isViableStructure(ctx, seed, structureType, p)) continue;
+
+                bestDistSq = distSq;
+                *pos = p;
             }
         }
-        
-        // Check in quadrants for better cache locality
-        for(int quadrant = 0; quadrant < 4; quadrant++) {
-            const int startX = (quadrant & 1) ? 0 : -radius;
-            const int endX = (quadrant & 1) ? radius : 0;
-            const int startZ = (quadrant & 2) ? 0 : -radius;
-            const int endZ = (quadrant & 2) ? radius : 0;
-            
-            for(int x = startX; x <= endX; x += step) {
-                for(int z = startZ; z <= endZ; z += step) {
-                    int distSq = x*x + z*z;
-                    if(distSq <= radiusSquared) {
-                        total++;
-                        if(getBiomeAt(&g, 4, (centerX + x) >> 2, 319>>2, (centerZ + z) >> 2) == biomeId) {
-                            count++;
-                            // Early success check
-                            if((float)count/total >= threshold && total >= 10) {
-                                return true;
-                            }
-                        } else {
-                            // Early failure check
-                            int remainingPoints = (radiusSquared / (step * step)) / 4; // Approximate remaining points
-                            if((float)(count + remainingPoints)/(total + remainingPoints) < threshold) {
-                                return false;
-                            }
-                        }
-                    }
+        return bestDistSq != INT64_MAX;
+    }
+
+    // Checks the End city query for a seed. The nearest matching city is
+    // stored in 'pos' and the number of matching cities in 'count'.
+    bool findEndCities(int64_t seed, Pos* pos, int* count) {
+        SeedContext& ctx = threadContext();
+        int32_t seed32 = (int32_t)(seed & 0xFFFFFFFF);
+        const int r = endCityQuery.radius;
+        const int regionRadius = (r / 320) + 1;  // 20 chunk regions
+
+        int matches = 0;
+        int64_t bestDistSq = INT64_MAX;
+        for (int regionX = -regionRadius; regionX <= regionRadius; ++regionX) {
+            for (int regionZ = -regionRadius; regionZ <= regionRadius; ++regionZ) {
+                if (shouldStop) return false;
+
+                Pos p;
+                if (!getBedrockStructurePos(End_City, ctx.end.mc, seed32, regionX, regionZ, &p)) {
+                    continue;
+                }
+                int64_t distSq = (int64_t)p.x*p.x + (int64_t)p.z*p.z;
+                if (distSq > (int64_t)r*r) continue;
+                if (!isEndCityViable(ctx, seed, p, endCityQuery.shipOnly)) continue;
+
+                matches++;
+                if (distSq < bestDistSq) {
+                    bestDistSq = distSq;
+                    *pos = p;
                 }
             }
         }
-        
-        return total > 0 && (float)count/total >= threshold;
+
+        *count = matches;
+        return matches >= endCityQuery.minCount;
     }
 
     bool findStructure(int64_t seed, Pos* pos, int radius) {
         try {
-            static thread_local Generator g;
-            static thread_local bool initialized = false;
-            
-            if (!initialized) {
-                setupGenerator(&g, MC_NEWEST, 0);
-                initialized = true;
-            }
+            SeedContext& ctx = threadContext();
 
             int32_t seed32 = (int32_t)(seed & 0xFFFFFFFF);
-            int regionRadius = (radius / 512) + 1;
+            // Spawn-relative searches first bound the distance from the origin
+            // by how far the spawn can be from it
+            bool fromSpawn = spawnRelative && !isNetherStructure(selectedStructure);
+            int reach = fromSpawn ? spawnMaxReach(ctx.g.mc) : 0;
+            int regionRadius = ((radius + reach) / 512) + 1;
 
             // Early structure position check before applying seed
             bool foundValidPosition = false;
@@ -1596,13 +4547,16 @@ public:
                     if (shouldStop) return false;
 
                     Pos p;
-                    if (!getBedrockStructurePos(selectedStructure, g.mc, seed32, regionX, regionZ, &p)) {
+                    if (!getBedrockStructurePos(selectedStructure, ctx.g.mc, seed32, regionX, regionZ, &p)) {
                         continue;
                     }
 
                     // Calculate distance from origin
                     int distance = (int)sqrt(p.x*p.x + p.z*p.z);
-                    if (distance < minSearchRadius || distance > radius) {
+                    if (distance < minSearchRadius - reach || distance > radius + reach) {
+                        continue;
+                    }
+                    if (fromSpawn && !withinSpawnDistance(ctx, seed, p, minSearchRadius, radius, &distance)) {
                         continue;
                     }
 
@@ -1620,81 +4574,653 @@ public:
                 return false;
             }
 
-            // Only initialize generator and apply seed if we found a potential position
-            g.seed = seed;
-            g.dim = DIM_OVERWORLD;
-            applySeed(&g, DIM_OVERWORLD, seed);
-
-            // Validate the best position found
-            if (!isViableStructurePos(selectedStructure, &g, bestPos.x, bestPos.z, 0)) {
+            // Validate the best position found, seeding only its dimension
+            if (!isViableStructure(ctx, seed, selectedStructure, bestPos)) {
                 return false;
             }
 
-            bool skipTerrainCheck = (selectedStructure == Ancient_City || 
-                                   selectedStructure == Monument);
-            
-            if (!skipTerrainCheck && !isViableStructureTerrain(selectedStructure, &g, bestPos.x, bestPos.z)) {
+            if (!isNetherStructure(selectedStructure) && surroundingBiome.enabled &&
+                !checkSurroundingBiomes(ctx, bestPos.x, bestPos.z, surroundingBiome)) {
                 return false;
             }
 
-            int biomeId = getBiomeAt(&g, 4, bestPos.x >> 2, 319>>2, bestPos.z >> 2);
-            if(biomeId == none) return false;
-            
-            bool validBiome = true;
-            if (selectedStructure == Monument) {
-                if (!isDeepOcean(biomeId)) {
-                    validBiome = false;
-                }
+            *pos = bestPos;
+            return true;
+
+        } catch (const std::exception& e) {
+            return false;
+        }
+    }
+
+    // Orders the enabled stages by their expected cost per rejected seed,
+    // estimated from the measured time and pass rate of each stage
+    int planStages(int order[STAGE_NUM]) {
+        // Rough cost in microseconds until a stage has been measured
+        static const double priorMicros[STAGE_NUM] = { 100.0, 5.0, 20.0, 50.0 };
+        double rank[STAGE_NUM];
+        int n = 0;
+
+        for (int st = 0; st < STAGE_NUM; st++) {
+            if (st != STAGE_BASE && !dimensionQueries[st].enabled) continue;
+            uint64_t calls = stageStats[st].calls.load(std::memory_order_relaxed);
+            uint64_t passes = stageStats[st].passes.load(std::memory_order_relaxed);
+            double cost = priorMicros[st];
+            if (calls >= 32)
+                cost = stageStats[st].nanos.load(std::memory_order_relaxed) / 1000.0 / calls;
+            double rejectRate = (calls - passes + 1.0) / (calls + 2.0);
+            rank[st] = cost / rejectRate;
+            order[n++] = st;
+        }
+        std::sort(order, order + n, [&rank](int a, int b) { return rank[a] < rank[b]; });
+        return n;
+    }
+
+    // Structure search together with the cross-dimension constraints, in the
+    // order chosen by planStages()
+    bool checkStructureQuery(int64_t seed, Pos* pos, Pos dimPos[DIMQ_NUM]) {
+        SeedContext& ctx = threadContext();
+        int order[STAGE_NUM];
+        int n = planStages(order);
+
+        for (int i = 0; i < n; i++) {
+            int st = order[i];
+            auto start = std::chrono::steady_clock::now();
+            bool pass;
+            if (st == STAGE_BASE) {
+                pass = multiStructureMode ? findMultipleStructures(seed, pos)
+                                          : findStructure(seed, pos, rankDistanceLimit(ctx, RANK_DISTANCE, maxSearchRadius));
+            } else {
+                const DimensionQuery& dq = dimensionQueries[st];
+                pass = findStructureNearOrigin(ctx, seed, dq.structureType, dq.maxDistance,
+                                               spawnRelative && st == DIMQ_OVERWORLD, &dimPos[st]);
             }
-            else if (selectedStructure == Mansion) {
-                if (biomeId != dark_forest) {
-                    validBiome = false;
-                }
+            auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+            StageStats& stats = stageStats[st];
+            stats.nanos.fetch_add(nanos, std::memory_order_relaxed);
+            stats.calls.fetch_add(1, std::memory_order_relaxed);
+            if (!pass) return false;
+            stats.passes.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Fills in the structure fields of the result of a seed that passed the
+    // structure query. Returns false if an attached structure is missing.
+    bool structureResult(SearchResult& r, const Pos dimPos[DIMQ_NUM]) {
+        bool complete = true;
+        r.type = multiStructureMode ? baseStructureType : selectedStructure;
+        if (multiStructureMode) {
+            // Only add to results if we found all required structures
+            for (const auto& attached : threadContext().attached) {
+                if (!attached.required) continue;
+                if (attached.found)
+                    addResultExtra(r, attached.structureType, EXTRA_ATTACHED, attached.foundPos);
+                else
+                    complete = false;
+            }
+        }
+        addDimensionExtras(r, dimPos);
+        if (spawnRelative && !isNetherStructure(r.type)) {
+            Pos spawn = worldSpawn(threadContext(), r.seed);
+            r.distance = (int)sqrt(pow(r.pos.x - spawn.x, 2) + pow(r.pos.z - spawn.z, 2));
+        }
+        return complete;
+    }
+
+    // The structure query as set up in the UI
+    QueryEnvelope currentEnvelope() {
+        QueryEnvelope q = {};
+        q.multi = multiStructureMode;
+        q.structureType = multiStructureMode ? baseStructureType : selectedStructure;
+        q.minRadius = minSearchRadius;
+        q.maxRadius = maxSearchRadius;
+        q.spawnRelative = spawnRelative;
+        bool optional = rankQuery.enabled && rankQuery.metric == RANK_CONSTRAINTS;
+        if (multiStructureMode && !optional) {
+            for (const auto& a : attachedStructures) {
+                if (!a.required || q.attachedCount >= MAX_ATTACHED) continue;
+                q.attached[q.attachedCount++] = { a.structureType, a.minDistance, a.maxDistance };
+            }
+        }
+        for (int d = 0; d < DIMQ_NUM; d++) {
+            const DimensionQuery& dq = dimensionQueries[d];
+            q.dims[d] = { dq.enabled, dq.structureType, dq.maxDistance };
+        }
+        q.surroundingEnabled = surroundingBiome.enabled;
+        q.surroundingBiome = surroundingBiome.biomeId;
+        q.surroundingRadius = surroundingBiome.radius;
+        q.surroundingCoverage = surroundingBiome.coverage;
+        q.bedrockRange = useBedrockRange;
+        q.mc = mcVersion;
+        q.rankMetric = rankQuery.enabled ? rankQuery.metric : -1;
+        q.rankK = rankQuery.k;
+        return q;
+    }
+
+    void saveCandidateQuery(const QueryEnvelope& q) {
+        candidateQuery.clear();
+        candidateQuery.append(q);
+        candidateQuery.flush();
+        candidateEnvelope = q;
+        hasCandidates = true;
+    }
+
+    // Constraints of 'now' that are looser than those of 'was', the query the
+    // candidates passed. Seeds that only pass because of them were never kept,
+    // so finding them takes a new search. Empty if 'now' is at least as strict.
+    std::vector<std::string> loosenedConstraints(const QueryEnvelope& was, const QueryEnvelope& now) {
+        static const char* dimNames[DIMQ_NUM] = { "Overworld", "Nether", "End" };
+        std::vector<std::string> out;
+        auto range = [](int lo, int hi) { return std::to_string(lo) + "-" + std::to_string(hi); };
+
+        if (now.multi != was.multi || now.structureType != was.structureType) {
+            out.push_back(std::string("Any seed: the candidates were searched for ") +
+                          struct2str(was.structureType) + (was.multi ? " with attached structures" : ""));
+            return out;
+        }
+        if (now.mc != was.mc) {
+            out.push_back(std::string("Any seed: the candidates were searched for ") + mc2str(was.mc));
+            return out;
+        }
+        if (now.spawnRelative != was.spawnRelative) {
+            out.push_back(std::string("Any seed: the candidates were measured from ") +
+                          (was.spawnRelative ? "world spawn" : "(0, 0)"));
+            return out;
+        }
+        if (now.minRadius < was.minRadius || now.maxRadius > was.maxRadius) {
+            out.push_back(std::string(struct2str(now.structureType)) + " " + range(now.minRadius, now.maxRadius) +
+                          " blocks away, outside " + range(was.minRadius, was.maxRadius));
+        }
+        for (int k = 0; k < was.attachedCount; k++) {
+            const auto& a = was.attached[k];
+            bool kept = false;
+            for (int j = 0; j < now.attachedCount && !kept; j++) {
+                const auto& b = now.attached[j];
+                kept = b.type == a.type && b.minDistance >= a.minDistance && b.maxDistance <= a.maxDistance;
+            }
+            if (!kept) {
+                out.push_back(std::string("No ") + struct2str(a.type) + " " +
+                              range(a.minDistance, a.maxDistance) + " blocks from the base");
+            }
+        }
+        for (int d = 0; d < DIMQ_NUM; d++) {
+            const auto& a = was.dims[d];
+            const auto& b = now.dims[d];
+            if (!a.enabled) continue;
+            if (!b.enabled || b.type != a.type || b.maxDistance > a.maxDistance) {
+                out.push_back(std::string("No ") + struct2str(a.type) + " within " + std::to_string(a.maxDistance) +
+                              " blocks in the " + dimNames[d]);
+            }
+        }
+        if (was.surroundingEnabled &&
+            (!now.surroundingEnabled || now.surroundingBiome != was.surroundingBiome ||
+             now.surroundingRadius != was.surroundingRadius || now.surroundingCoverage < was.surroundingCoverage)) {
+            char coverage[16];
+            snprintf(coverage, sizeof(coverage), "%.0f%%", was.surroundingCoverage * 100.0);
+            out.push_back(std::string("Less than ") + coverage + " " + biome2str(was.mc, was.surroundingBiome) +
+                          " within " + std::to_string(was.surroundingRadius) + " blocks");
+        }
+        if (now.bedrockRange != was.bedrockRange) {
+            out.push_back(std::string("Seeds outside the ") + (was.bedrockRange ? "32-bit" : "64-bit") + " range");
+        }
+        if (was.rankMetric >= 0) {
+            out.push_back("Seeds the ranked search skipped once its best " + std::to_string(was.rankK) +
+                          " were known");
+        }
+        return out;
+    }
+
+    // Checks one seed against the structure query and records it as a result
+    // or in the thread's ranking. A new search (not a refinement) also keeps
+    // the seed as a candidate and stops at the first hit unless continuous.
+    void checkSeed(int64_t seed, std::vector<RankedResult>& localRanked,
+                   std::chrono::steady_clock::time_point& lastMerge, bool fresh) {
+        if (ranking) {
+            SeedContext& ctx = threadContext();
+            ctx.rankCutoff = rankThreshold.load(std::memory_order_relaxed);
+            if (localRanked.size() >= rankK)
+                ctx.rankCutoff = std::max(ctx.rankCutoff, localRanked.front().score);
+        }
+
+        Pos pos;
+        Pos dimPos[DIMQ_NUM];
+        if (checkStructureQuery(seed, &pos, dimPos)) {
+            SearchResult r = {};
+            r.seed = seed;
+            r.kind = SEARCH_STRUCTURES;
+            r.mc = mcVersion;
+            r.pos = pos;
+            r.distance = (int)sqrt((double)pos.x*pos.x + (double)pos.z*pos.z);
+            bool complete = structureResult(r, dimPos);
+            bool passed = complete || (ranking && rankMetric == RANK_CONSTRAINTS);
+            if (fresh && passed) candidates.append(seed);
+
+            if (ranking) {
+                if (passed) offerRanked(localRanked, rankK, { rankScore(r), r });
+            } else if (complete) {
+                std::lock_guard<std::mutex> lock(structuresMutex);
+                results.append(r);
+                currentStatus = resultStatus(r);
+                if (fresh && !continuousSearch) shouldStop = true;
             }
-            else if (selectedStructure == Shipwreck) {
-                if (!isShipwreckBiome(biomeId)) {
-                    validBiome = false;
+        }
+
+        if (ranking && !localRanked.empty() &&
+            std::chrono::steady_clock::now() - lastMerge >= std::chrono::milliseconds(rankMergeMillis)) {
+            mergeRanked(localRanked);
+            lastMerge = std::chrono::steady_clock::now();
+        }
+    }
+
+    // Re-checks the candidates against the current query. Each of the n
+    // threads takes every n-th candidate.
+    void refineWorker(int thread, int n) {
+        std::vector<RankedResult> localRanked;
+        auto lastMerge = std::chrono::steady_clock::now();
+        size_t total = candidates.size();
+
+        for (size_t i = thread; i < total && !shouldStop; i += n) {
+            int64_t seed;
+            if (!candidates.get(i, &seed)) break;
+            checkSeed(seed, localRanked, lastMerge, false);
+            seedsChecked++;
+        }
+        if (ranking) mergeRanked(localRanked);
+
+        if (--refineThreadsLeft == 0 && !shouldStop) {
+            if (ranking) publishRanking(true);
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            currentStatus = "✅ Refined " + std::to_string(total) + " candidates, " +
+                            std::to_string(results.size()) + " seeds found";
+        }
+    }
+
+    // Bitmaps of the newest version keep their unversioned names
+    static std::string bitmapName(int structureType, int mc, int radius) {
+        std::string name = "proximity_" + std::to_string(structureType) + "_" + std::to_string(radius);
+        if (mc != MC_NEWEST) name += std::string("_") + mc2str(mc);
+        return name + ".bits";
+    }
+
+    static std::string bitmapPath(int structureType, int mc, int radius) {
+        return std::string(bitmapDir) + "/" + bitmapName(structureType, mc, radius);
+    }
+
+    // Finds the bitmaps of the search version on disk, by their file names
+    void refreshBitmapList() {
+        std::set<std::pair<int, int>> found;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(bitmapDir, ec)) {
+            int type, radius;
+            std::string name = entry.path().filename().string();
+            if (sscanf(name.c_str(), "proximity_%d_%d", &type, &radius) == 2 &&
+                name == bitmapName(type, mcVersion, radius))
+                found.insert({ type, radius });
+        }
+        std::lock_guard<std::mutex> lock(structuresMutex);
+        builtBitmaps = found;
+    }
+
+    // Computes the bitmap of a structure type and radius with all threads and
+    // writes it to the bitmap directory
+    void runBitmapBuild(int structureType, int mc, int radius) {
+        auto setStatus = [this](const std::string& text) {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            bitmapStatus = text;
+        };
+        auto start = std::chrono::steady_clock::now();
+
+        ProximityBitmap pb;
+        if (!allocProximityBitmap(&pb, structureType, mc, radius)) {
+            setStatus("⚠️ Not enough memory for a 512 MB bitmap");
+            bitmapBusy = false;
+            return;
+        }
+        setStatus(std::string("Building ") + struct2str(structureType) + " within " +
+                  std::to_string(radius) + " blocks...");
+
+        const uint64_t total = UINT64_C(1) << 32;
+        const uint64_t block = UINT64_C(1) << 20;
+        std::atomic<uint64_t> next{0};
+        int n = std::max(1, appSettings.threadCount);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < n; i++) {
+            workers.emplace_back([&]() {
+                uint64_t b;
+                while (!bitmapCancel && (b = next.fetch_add(block)) < total) {
+                    fillProximityBitmap(&pb, (uint32_t)b, block);
+                    bitmapProgress += block;
+                }
+            });
+        }
+        for (auto& t : workers) t.join();
+
+        if (bitmapCancel) {
+            setStatus("Build cancelled");
+        } else {
+            std::error_code ec;
+            std::filesystem::create_directories(bitmapDir, ec);
+            std::string path = bitmapPath(structureType, mc, radius);
+            char seconds[32];
+            snprintf(seconds, sizeof(seconds), "%.0fs", std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count());
+            setStatus(saveProximityBitmap(&pb, path.c_str()) ? "Built " + path + " in " + seconds
+                                                             : "⚠️ Could not write " + path);
+        }
+        freeProximityBitmap(&pb);
+        refreshBitmapList();
+        bitmapBusy = false;
+    }
+
+    // Maps the smallest built bitmap covering each "structure within R of the
+    // origin" constraint of the query and returns what they stand for
+    std::string mapSearchBitmaps() {
+        unmapSearchBitmaps();
+        std::vector<std::pair<int, int>> needed;  // (structure type, radius)
+        int base = multiStructureMode ? baseStructureType : selectedStructure;
+        if (!spawnRelative || isNetherStructure(base)) {
+            needed.push_back({ base, maxSearchRadius });
+            bool optional = rankQuery.enabled && rankQuery.metric == RANK_CONSTRAINTS;
+            if (multiStructureMode && !optional) {
+                // Attached structures are at most their distance from the base
+                for (const auto& a : attachedStructures) {
+                    if (a.required) needed.push_back({ a.structureType, maxSearchRadius + a.maxDistance + 1 });
                 }
             }
-            else if (selectedStructure == Village) {
-                if (!isVillageBiome(biomeId)) {
-                    validBiome = false;
+        }
+        for (int d = 0; d < DIMQ_NUM; d++) {
+            const DimensionQuery& dq = dimensionQueries[d];
+            if (dq.enabled && !(spawnRelative && d == DIMQ_OVERWORLD))
+                needed.push_back({ dq.structureType, dq.maxDistance });
+        }
+
+        std::set<std::pair<int, int>> built;
+        {
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            built = builtBitmaps;
+        }
+        std::set<std::pair<int, int>> chosen;
+        for (const auto& need : needed) {
+            for (int r : proximityRadii) {
+                if (r >= need.second && built.count({ need.first, r })) {
+                    chosen.insert({ need.first, r });
+                    break;
                 }
             }
+        }
+
+        std::string used;
+        for (const auto& c : chosen) {
+            ProximityBitmap pb;
+            if (!loadProximityBitmap(&pb, bitmapPath(c.first, mcVersion, c.second).c_str(), c.first, mcVersion,
+                                     c.second))
+                continue;
+            searchBitmaps.push_back(pb);
+            if (!used.empty()) used += " and ";
+            used += std::string(struct2str(c.first)) + " within " + std::to_string(c.second);
+        }
+        return used;
+    }
 
-            if (!validBiome) return false;
+    void unmapSearchBitmaps() {
+        for (ProximityBitmap& pb : searchBitmaps) freeProximityBitmap(&pb);
+        searchBitmaps.clear();
+    }
 
-            *pos = bestPos;
+    // Walks the 32-bit seeds in blocks, ANDs the mapped bitmaps of a block and
+    // only checks the seeds left
+    void bitmapScanWorker(int thread) {
+        const uint64_t blockWords = UINT64_C(1) << 14;  // 2^20 seeds
+        std::vector<const uint64_t*> maps;
+        for (const ProximityBitmap& pb : searchBitmaps) maps.push_back(pb.bits);
+        std::vector<uint32_t> seeds(blockWords * 64);
+        std::vector<RankedResult> localRanked;
+        auto lastMerge = std::chrono::steady_clock::now();
+
+        uint64_t w;
+        while (!shouldStop && (w = bitmapNextWord.fetch_add(blockWords)) < PROXIMITY_WORDS) {
+            size_t n = intersectProximityBits(maps.data(), (int)maps.size(), w, w + blockWords,
+                                              seeds.data(), seeds.size());
+            for (size_t i = 0; i < n && !shouldStop; i++) {
+                checkSeed((int32_t)seeds[i], localRanked, lastMerge, true);
+            }
+            seedsChecked += blockWords * 64;
+
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            currentSeed = (int32_t)(w << 6);
+            if (currentStatus.rfind("[FOUND]", 0) != 0) {
+                char progress[96];
+                snprintf(progress, sizeof(progress), "[T%d] Scanned %.1f%% of the 32-bit seeds, %zu left by the bitmaps",
+                         thread, (w + blockWords) * 100.0 / PROXIMITY_WORDS, n);
+                currentStatus = progress;
+            }
+        }
+        if (ranking) mergeRanked(localRanked);
+
+        if (--bitmapThreadsLeft == 0 && !shouldStop) {
+            if (ranking) publishRanking(true);
+            std::lock_guard<std::mutex> lock(structuresMutex);
+            currentStatus = "✅ All 2^32 seeds scanned, " + std::to_string(results.size()) + " seeds found";
+        }
+    }
+
+    // Distance from the base to its farthest attached structure
+    static int clusterSpread(const SearchResult& r) {
+        int spread = 0;
+        for (int k = 0; k < r.extraCount; k++) {
+            const ResultExtra& e = r.extras[k];
+            if (e.dim != EXTRA_ATTACHED) continue;
+            Pos p = inDimensionOf(r.type, e.type, e.pos);
+            double dx = p.x - r.pos.x, dz = p.z - r.pos.z;
+            spread = std::max(spread, (int)sqrt(dx*dx + dz*dz));
+        }
+        return spread;
+    }
+
+    static int attachedCount(const SearchResult& r) {
+        int n = 0;
+        for (int k = 0; k < r.extraCount; k++)
+            n += r.extras[k].dim == EXTRA_ATTACHED;
+        return n;
+    }
+
+    // Ranking score of a result under rankMetric, higher is better.
+    // Distances are whole blocks, so the tie-breaks stay below one point.
+    double rankScore(const SearchResult& r) const {
+        switch (rankMetric) {
+        case RANK_CLUSTER:
+            return -(clusterSpread(r) + r.distance / rankConstraintWeight);
+        case RANK_CONSTRAINTS:
+            return attachedCount(r) * rankConstraintWeight - r.distance;
+        default:
+            return -(double)r.distance;
+        }
+    }
+
+    // Keeps the k best results in a min-heap, worst on top. Returns whether
+    // the result was kept.
+    static bool offerRanked(std::vector<RankedResult>& heap, size_t k, const RankedResult& rr) {
+        auto worse = [](const RankedResult& a, const RankedResult& b) { return a.score > b.score; };
+        if (heap.size() < k) {
+            heap.push_back(rr);
+            std::push_heap(heap.begin(), heap.end(), worse);
             return true;
+        }
+        if (rr.score <= heap.front().score) return false;
+        std::pop_heap(heap.begin(), heap.end(), worse);
+        heap.back() = rr;
+        std::push_heap(heap.begin(), heap.end(), worse);
+        return true;
+    }
 
-        } catch (const std::exception& e) {
-            return false;
+    // Moves a thread's ranked results into the shared ranking and publishes
+    // the K-th best score as the new cutoff
+    void mergeRanked(std::vector<RankedResult>& local) {
+        std::lock_guard<std::mutex> lock(structuresMutex);
+        for (const RankedResult& rr : local) {
+            bool full = ranked.size() >= rankK;
+            if (full && rr.score <= ranked.front().score) continue;
+            if (!rankedSeeds.insert(rr.result.seed).second) continue;  // found by another thread
+            if (full) rankedSeeds.erase(ranked.front().result.seed);
+            offerRanked(ranked, rankK, rr);
+            rankChanged = true;
+        }
+        local.clear();
+        if (ranked.size() >= rankK)
+            rankThreshold.store(ranked.front().score, std::memory_order_relaxed);
+    }
+
+    // Rewrites the journal with the current ranking, best first, so the
+    // results table and the exporters show it as is
+    void publishRanking(bool force = false) {
+        std::lock_guard<std::mutex> lock(structuresMutex);
+        auto now = std::chrono::steady_clock::now();
+        if (!rankChanged) return;
+        if (!force && now - rankPublishedAt < std::chrono::milliseconds(rankPublishMillis)) return;
+
+        std::vector<RankedResult> best = ranked;
+        std::sort(best.begin(), best.end(), [](const RankedResult& a, const RankedResult& b) {
+            return a.score > b.score;
+        });
+        results.clear();
+        for (const RankedResult& rr : best) results.append(rr.result);
+        results.flush();
+        resultsVersion++;
+        rankChanged = false;
+        rankPublishedAt = now;
+    }
+
+    // Largest distance that can still beat the ranking cutoff of the seed
+    // under 'metric', capped at 'limit'. Structures beyond it are skipped
+    // right after placement.
+    int rankDistanceLimit(const SeedContext& ctx, int metric, int limit) const {
+        if (!ranking || rankMetric != metric || ctx.rankCutoff == -INFINITY) return limit;
+        return (int)std::min<double>(limit, std::ceil(-ctx.rankCutoff) - 1);
+    }
+
+    // RESULT_MAX_EXTRAS covers every query, the check only guards the record
+    void addResultExtra(SearchResult& r, int type, int dim, Pos pos) {
+        if (r.extraCount >= RESULT_MAX_EXTRAS) return;
+        r.extras[r.extraCount++] = { type, dim, pos };
+    }
+
+    // Adds the world spawn and the structures of the enabled cross-dimension
+    // constraints to a result
+    void addDimensionExtras(SearchResult& r, const Pos dimPos[DIMQ_NUM]) {
+        if (spawnRelative) {
+            // cached by the search that just accepted the seed
+            addResultExtra(r, EXTRA_SPAWN, DIMQ_OVERWORLD, worldSpawn(threadContext(), r.seed));
+        }
+        for (int d = 0; d < DIMQ_NUM; d++) {
+            if (dimensionQueries[d].enabled)
+                addResultExtra(r, dimensionQueries[d].structureType, d, dimPos[d]);
+        }
+    }
+
+    // Game version a result was found in, which the version selector may
+    // have changed since
+    int resultVersion(const SearchResult& r) const {
+        return r.mc != MC_UNDEF ? r.mc : mcVersion;
+    }
+
+    // What a result found, e.g. "Village" or "Giant Ravine x3"
+    std::string resultLabel(const SearchResult& r) {
+        std::string name;
+        switch (r.kind) {
+        case SEARCH_BIOMES: {
+            char percent[32];
+            snprintf(percent, sizeof(percent), " (%.2f%%)", r.value * 100.0);
+            name = std::string(biome2str(resultVersion(r), r.type)) + percent;
+            if (r.flags & RESULT_AREA) {
+                std::string side = std::to_string(r.count);
+                name += ", " + side + "x" + side + " area";
+            }
+            return name;
+        }
+        case SEARCH_RAVINES:
+        case SEARCH_END_CITIES:
+            if (r.kind == SEARCH_END_CITIES)
+                name = (r.flags & RESULT_SHIP) ? "End City with Ship" : "End City";
+            else
+                name = (r.flags & RESULT_GIANT) ? "Giant Ravine" : "Ravine";
+            if (r.count > 1) name += " x" + std::to_string(r.count);
+            return name;
+        case SEARCH_QUADS:
+            return "Quad Swamp Hut (" + std::to_string(r.count) + " spawning spaces)";
+        default:
+            return struct2str(r.type);
         }
     }
 
+    std::string extraLabel(const ResultExtra& e) {
+        static const char* dimNames[DIMQ_NUM] = { "Overworld", "Nether", "End" };
+        if (e.type == EXTRA_SPAWN) return "World Spawn";
+        std::string name = struct2str(e.type);
+        if (e.dim != EXTRA_ATTACHED) name += std::string(" (") + dimNames[e.dim] + ")";
+        return name;
+    }
+
+    static std::string coordText(Pos p) {
+        return "[" + std::to_string(p.x) + ", " + std::to_string(p.z) + "]";
+    }
+
+    // Status line announcing a result
+    std::string resultStatus(const SearchResult& r) {
+        std::string msg = "[FOUND] Seed: " + std::to_string(r.seed);
+        switch (r.kind) {
+        case SEARCH_BIOMES:
+            return msg + " | " + resultLabel(r) + ((r.flags & RESULT_AREA) ? " centered at " : " nearest at ") +
+                   coordText(r.pos);
+        case SEARCH_RAVINES:
+        case SEARCH_END_CITIES:
+            return msg + " | " + resultLabel(r) + " nearest at " + coordText(r.pos);
+        case SEARCH_QUADS:
+            return msg + " | " + resultLabel(r) + ", AFK at " + coordText(r.pos);
+        default:
+            break;
+        }
+
+        bool multi = r.extraCount > 0 && r.extras[0].dim == EXTRA_ATTACHED;
+        if (multi) {
+            msg += "\nBase " + resultLabel(r) + ": " + coordText(r.pos);
+        } else {
+            msg += " | Coords: " + coordText(r.pos) + " | Distance: " + std::to_string(r.distance) + "m";
+        }
+        for (int k = 0; k < r.extraCount; k++) {
+            const ResultExtra& e = r.extras[k];
+            if (e.dim == EXTRA_ATTACHED) {
+                Pos p = inDimensionOf(r.type, e.type, e.pos);
+                double dx = p.x - r.pos.x, dz = p.z - r.pos.z;
+                msg += "\n" + extraLabel(e) + ": " + coordText(e.pos) +
+                       " (Distance: " + std::to_string((int)sqrt(dx*dx + dz*dz)) + "m)";
+            } else {
+                msg += "\n+ " + extraLabel(e) + " " + coordText(e.pos);
+            }
+        }
+        return msg;
+    }
+
     bool findMultipleStructures(int64_t seed, Pos* basePos) {
         try {
-            static thread_local Generator g;
-            static thread_local bool initialized = false;
-            
-            if (!initialized) {
-                setupGenerator(&g, MC_NEWEST, 0);
-                initialized = true;
-            }
+            SeedContext& ctx = threadContext();
 
             int32_t seed32 = (int32_t)(seed & 0xFFFFFFFF);
             std::vector<std::pair<int, Pos>> allFoundStructures;
 
             // First find the base structure
             selectedStructure = baseStructureType;
-            if (!findStructure(seed, basePos, maxSearchRadius)) {
+            if (!findStructure(seed, basePos, rankDistanceLimit(ctx, RANK_DISTANCE, maxSearchRadius))) {
                 return false;
             }
             allFoundStructures.push_back({baseStructureType, *basePos});
 
-            // Count enabled structures
+            // Count enabled structures. Results are kept per thread, as the
+            // threads check different seeds at the same time.
+            ctx.attached = attachedStructures;
             int enabledCount = 0;
-            for (auto& attached : attachedStructures) {
+            for (auto& attached : ctx.attached) {
                 if (attached.required) {
                     enabledCount++;
                     attached.found = false;
@@ -1703,78 +5229,76 @@ public:
 
             if (enabledCount == 0) return true;
 
-            // Initialize generator once
-            g.seed = seed;
-            g.dim = DIM_OVERWORLD;
-            applySeed(&g, DIM_OVERWORLD, seed);
+            // Ranked by the number of attached structures, missing ones are allowed
+            bool optional = ranking && rankMetric == RANK_CONSTRAINTS;
+            int foundCount = 0;
+            int remaining = enabledCount;
 
             // For each required structure
-            for (auto& attached : attachedStructures) {
+            for (auto& attached : ctx.attached) {
                 if (!attached.required) continue;
 
-                int regionRadius = (attached.maxDistance / 512) + 1;
+                // Stop once even finding all the remaining ones cannot make the ranking
+                if (optional && (foundCount + remaining) * rankConstraintWeight <= ctx.rankCutoff) {
+                    return false;
+                }
+                remaining--;
+
+                int maxDistance = rankDistanceLimit(ctx, RANK_CLUSTER, attached.maxDistance);
                 std::vector<Pos> validPositions;
 
+                // Distances are measured in the base structure's dimension. The
+                // regions are searched around the base in the attached
+                // structure's own dimension.
+                const int type = attached.structureType;
+                StructureConfig sconf;
+                if (!getBedrockStructureConfig(type, ctx.g.mc, &sconf)) {
+                    if (optional) continue;
+                    return false;
+                }
+                Pos center = inDimensionOf(type, baseStructureType, *basePos);
+                int reach = maxDistance;
+                if (isNetherStructure(type) != isNetherStructure(baseStructureType))
+                    reach = isNetherStructure(type) ? maxDistance / 8 + 1 : maxDistance * 8 + 8;
+                const int span = sconf.regionSize * 16;
+                auto region = [span](int v) { return v < 0 ? (v - span + 1) / span : v / span; };
+
                 // Search all regions for valid positions
-                for (int regionX = -regionRadius; regionX <= regionRadius; ++regionX) {
-                    for (int regionZ = -regionRadius; regionZ <= regionRadius; ++regionZ) {
+                for (int regionX = region(center.x - reach); regionX <= region(center.x + reach); ++regionX) {
+                    for (int regionZ = region(center.z - reach); regionZ <= region(center.z + reach); ++regionZ) {
                         if (shouldStop) return false;
 
                         Pos p;
-                        if (!getBedrockStructurePos(attached.structureType, g.mc, seed32, regionX, regionZ, &p)) {
+                        if (!getBedrockStructurePos(type, ctx.g.mc, seed32, regionX, regionZ, &p)) {
                             continue;
                         }
 
                         // Check distance from base structure
-                        int dx = p.x - basePos->x;
-                        int dz = p.z - basePos->z;
+                        Pos q = inDimensionOf(baseStructureType, type, p);
+                        double dx = q.x - basePos->x;
+                        double dz = q.z - basePos->z;
                         int distance = (int)sqrt(dx*dx + dz*dz);
                         
-                        if (distance < attached.minDistance || distance > attached.maxDistance) {
+                        if (distance < attached.minDistance || distance > maxDistance) {
                             continue;
                         }
 
                         // Check if this exact position was already used
                         bool positionUsed = false;
                         for (const auto& found : allFoundStructures) {
-                            if (p.x == found.second.x && p.z == found.second.z) {
+                            if (isNetherStructure(found.first) == isNetherStructure(type) &&
+                                p.x == found.second.x && p.z == found.second.z) {
                                 positionUsed = true;
                                 break;
                             }
                         }
                         if (positionUsed) continue;
 
-                        // Basic validation
-                        if (!isViableStructurePos(attached.structureType, &g, p.x, p.z, 0)) {
-                            continue;
-                        }
-
-                        bool skipTerrainCheck = (attached.structureType == Ancient_City || 
-                                               attached.structureType == Monument);
-                        
-                        if (!skipTerrainCheck && !isViableStructureTerrain(attached.structureType, &g, p.x, p.z)) {
+                        // Reuses the generator and biome hint from the base structure check
+                        if (!isViableStructure(ctx, seed, type, p)) {
                             continue;
                         }
 
-                        int biomeId = getBiomeAt(&g, 4, p.x >> 2, 319>>2, p.z >> 2);
-                        if (biomeId == none) continue;
-
-                        bool validBiome = true;
-                        if (attached.structureType == Monument && !isDeepOcean(biomeId)) {
-                            validBiome = false;
-                        }
-                        else if (attached.structureType == Mansion && biomeId != dark_forest) {
-                            validBiome = false;
-                        }
-                        else if (attached.structureType == Shipwreck && !isShipwreckBiome(biomeId)) {
-                            validBiome = false;
-                        }
-                        else if (attached.structureType == Village && !isVillageBiome(biomeId)) {
-                            validBiome = false;
-                        }
-
-                        if (!validBiome) continue;
-
                         // Add to valid positions if it passed all checks
                         validPositions.push_back(p);
                     }
@@ -1782,22 +5306,26 @@ public:
 
                 // If no valid positions found, fail
                 if (validPositions.empty()) {
+                    if (optional) continue;
                     return false;
                 }
 
                 // Sort valid positions by distance from base
                 std::sort(validPositions.begin(), validPositions.end(), 
-                    [basePos](const Pos& a, const Pos& b) {
-                        int dxa = a.x - basePos->x;
-                        int dza = a.z - basePos->z;
-                        int dxb = b.x - basePos->x;
-                        int dzb = b.z - basePos->z;
+                    [this, basePos, type](const Pos& pa, const Pos& pb) {
+                        Pos a = inDimensionOf(baseStructureType, type, pa);
+                        Pos b = inDimensionOf(baseStructureType, type, pb);
+                        int64_t dxa = a.x - basePos->x;
+                        int64_t dza = a.z - basePos->z;
+                        int64_t dxb = b.x - basePos->x;
+                        int64_t dzb = b.z - basePos->z;
                         return (dxa*dxa + dza*dza) < (dxb*dxb + dzb*dzb);
                     });
 
                 // Use the first valid position (closest to base)
                 attached.foundPos = validPositions[0];
                 attached.found = true;
+                foundCount++;
                 allFoundStructures.push_back({attached.structureType, validPositions[0]});
             }
 
@@ -11,6 +11,11 @@
 #include <stdio.h>
 #include <math.h>
 #include <float.h>
+#include <limits.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 
 
 //==============================================================================
@@ -335,26 +340,32 @@ int genNetherScaled(const NetherNoise *nn, int *out, Range r, int mc, uint64_t s
             src = NULL;
         }
 
-        int i, j, k;
+        int i, j, k, n;
         int *p = out;
         for (k = 0; k < r.sy; k++)
         {
             for (j = 0; j < r.sz; j++)
             {
-                for (i = 0; i < r.sx; i++)
+                for (i = 0; i < r.sx; i += 64)
                 {
-                    int x4, z4, y4;
-                    voronoiAccess3D(sha, r.x+i, r.y+k, r.z+j, &x4, &y4, &z4);
-                    if (src)
-                    {
-                        x4 -= s.x; y4 -= s.y; z4 -= s.z;
-                        *p = src[(int64_t)y4*s.sx*s.sz + (int64_t)z4*s.sx + x4];
-                    }
-                    else
+                    int x4[64], y4[64], z4[64], cnt = r.sx - i;
+                    if (cnt > 64)
+                        cnt = 64;
+                    voronoiAccessRow(sha, r.x+i, r.y+k, r.z+j, cnt, x4, y4, z4);
+                    for (n = 0; n < cnt; n++, p++)
                     {
-                        *p = getNetherBiome(nn, x4, y4, z4, NULL);
+                        if (src)
+                        {
+                            int64_t xs = x4[n] - s.x;
+                            int64_t ys = y4[n] - s.y;
+                            int64_t zs = z4[n] - s.z;
+                            *p = src[ys*s.sx*s.sz + zs*s.sx + xs];
+                        }
+                        else
+                        {
+                            *p = getNetherBiome(nn, x4[n], y4[n], z4[n], NULL);
+                        }
                     }
-                    p++;
                 }
             }
         }
@@ -1134,6 +1145,8 @@ void initBiomeNoise(BiomeNoise *bn, int mc)
 
     bn->sp = sp;
     bn->mc = mc;
+    bn->ft = NULL;
+    bn->hint = NULL;
 }
 
 
@@ -1186,10 +1199,83 @@ int sampleBiomeNoise(const BiomeNoise *bn, int64_t *np, int x, int y, int z,
 
     int id = none;
     if (!(sample_flags & SAMPLE_NO_BIOME))
-        id = climateToBiome(bn->mc, (const uint64_t*)p_np, dat);
+    {
+        if (!dat)
+            dat = bn->hint;
+        if (bn->ft)
+            id = climateToBiomeFlat(bn->ft, (const uint64_t*)p_np, dat);
+        else
+            id = climateToBiome(bn->mc, (const uint64_t*)p_np, dat);
+    }
     return id;
 }
 
+/* Bounds a double perlin noise at (px, pz) when only the first 'noct'
+ * octaves of each octave group are sampled. The octaves are ordered from the
+ * lowest frequency, so the skipped ones contribute the least amplitude.
+ */
+static void approxDoublePerlin(const DoublePerlinNoise *dpn, double px,
+    double pz, int noct, double *vmin, double *vmax)
+{
+    // The largest magnitude found for (improved) perlin noise is about 1.0363.
+    const double perlin_max = 1.04;
+    const double f = 337.0 / 331.0;
+    const OctaveNoise *oct[2] = { &dpn->octA, &dpn->octB };
+    double v = 0, r = 0;
+    int i, k;
+
+    for (k = 0; k < 2; k++)
+    {
+        double x = k ? px * f : px;
+        double z = k ? pz * f : pz;
+        for (i = 0; i < oct[k]->octcnt; i++)
+        {
+            const PerlinNoise *p = oct[k]->octaves + i;
+            if (i < noct)
+            {
+                double lf = p->lacunarity;
+                v += p->amplitude * samplePerlin(p, x * lf, 0, z * lf, 0, 0);
+            }
+            else
+            {
+                r += fabs(p->amplitude) * perlin_max;
+            }
+        }
+    }
+    *vmin = (v - r) * dpn->amplitude;
+    *vmax = (v + r) * dpn->amplitude;
+}
+
+void sampleBiomeNoiseApprox(const BiomeNoise *bn, int limits[6][2],
+    int x, int z, int noct, uint32_t sample_flags)
+{
+    static const int para[] = {
+        NP_TEMPERATURE, NP_HUMIDITY, NP_CONTINENTALNESS, NP_EROSION, NP_WEIRDNESS
+    };
+    double px = x, pz = z, vmin, vmax;
+    int i;
+
+    // the shift has few octaves and a displaced position would invalidate the
+    // sampled high frequency octaves, so it is always sampled exactly
+    if (!(sample_flags & SAMPLE_NO_SHIFT))
+    {
+        px += sampleDoublePerlin(&bn->climate[NP_SHIFT], x, 0, z) * 4.0;
+        pz += sampleDoublePerlin(&bn->climate[NP_SHIFT], z, x, 0) * 4.0;
+    }
+
+    for (i = 0; i < 5; i++)
+    {
+        int np = para[i];
+        approxDoublePerlin(&bn->climate[np], px, pz, noct, &vmin, &vmax);
+        // margin for the float conversion and truncation in sampleBiomeNoise
+        limits[np][0] = (int) floor(10000.0 * vmin) - 1;
+        limits[np][1] = (int) ceil(10000.0 * vmax) + 1;
+    }
+    // the depth depends on the terrain spline and the height, do not bound it
+    limits[NP_DEPTH][0] = INT_MIN;
+    limits[NP_DEPTH][1] = INT_MAX;
+}
+
 // Note: Climate noise is sampled at a 1:1 scale.
 int sampleBiomeNoiseBeta(const BiomeNoiseBeta *bnb, int64_t *np, double *nv,
     int x, int z)
@@ -1430,8 +1516,7 @@ int get_resulting_node(const uint64_t np[6], const BiomeTree *bt, int idx,
     return leaf;
 }
 
-ATTR(hot, flatten)
-int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat)
+static const BiomeTree *getBiomeTree(int mc)
 {
     static const BiomeTree btree18 = {
         btree18_steps, &btree18_param[0][0], btree18_nodes, btree18_order,
@@ -1454,19 +1539,23 @@ int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat)
         sizeof(btree21wd_nodes) / sizeof(uint64_t)
     };
 
-    const BiomeTree *bt;
-    int idx;
-
     if (mc >= MC_1_21_WD)
-        bt = &btree21wd;
+        return &btree21wd;
     else if (mc >= MC_1_20_6)
-        bt = &btree20;
+        return &btree20;
     else if (mc >= MC_1_19_4)
-        bt = &btree19;
+        return &btree19;
     else if (mc >= MC_1_19_2)
-        bt = &btree192;
+        return &btree192;
     else
-        bt = &btree18;
+        return &btree18;
+}
+
+ATTR(hot, flatten)
+int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat)
+{
+    const BiomeTree *bt = getBiomeTree(mc);
+    int idx;
 
     if (dat)
     {
@@ -1484,6 +1573,240 @@ int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat)
 }
 
 
+int initBiomeTreeFlat(BiomeTreeFlat *ft, int mc)
+{
+    const BiomeTree *bt = getBiomeTree(mc);
+    int width = (bt->order + 3) & ~3;
+    uint32_t i;
+
+    memset(ft, 0, sizeof(*ft));
+    for (i = 0; bt->steps[i]; i++);
+    if (bt->order > 16 || i >= 8)
+        return 0; // exceeds the traversal stack in climateToBiomeFlat()
+
+    // there cannot be more blocks than nodes, shrink when done
+    int16_t *bounds = (int16_t*) malloc(sizeof(int16_t) * bt->len * 12 * width);
+    int32_t *child = (int32_t*) malloc(sizeof(int32_t) * bt->len * width);
+    uint8_t *count = (uint8_t*) malloc(sizeof(uint8_t) * bt->len);
+    // breadth-first queue of the inner nodes and their depths
+    uint32_t *queue = (uint32_t*) malloc(sizeof(uint32_t) * bt->len * 2);
+    if (!bounds || !child || !count || !queue)
+        goto L_fail;
+
+    uint32_t qhead = 0, qtail = 0, nblocks = 0;
+    queue[qtail++] = 0;
+    queue[qtail++] = 0;
+    nblocks = 1;
+
+    while (qhead < qtail)
+    {
+        uint32_t idx = queue[qhead++];
+        int depth = queue[qhead++];
+        int blk = qhead / 2 - 1;
+        uint32_t step;
+
+        // same child enumeration as get_resulting_node()
+        do
+        {
+            step = bt->steps[depth];
+            depth++;
+        }
+        while (idx+step >= bt->len);
+
+        int16_t *lo = bounds + blk * 12 * width;
+        int16_t *hi = lo + 6 * width;
+        uint32_t inner = bt->nodes[idx] >> 48;
+        uint32_t n = 0;
+        memset(lo, 0, sizeof(int16_t) * 12 * width);
+        for (i = 0; i < (uint32_t)width; i++)
+            child[blk * width + i] = ~0;
+
+        for (n = 0; n < bt->order; )
+        {
+            uint64_t node = bt->nodes[inner];
+            int j;
+            for (j = 0; j < 6; j++)
+            {
+                int p = (node >> 8*j) & 0xFF;
+                int32_t l = bt->param[2*p + 0], h = bt->param[2*p + 1];
+                if (l < INT16_MIN || h > INT16_MAX || l > h)
+                    goto L_fail; // the bounds are packed into 16 bits
+                lo[j * width + n] = l;
+                hi[j * width + n] = h;
+            }
+            if (bt->steps[depth] == 0)
+            {
+                child[blk * width + n] = ~(int32_t)inner;
+            }
+            else
+            {
+                child[blk * width + n] = nblocks++;
+                queue[qtail++] = inner;
+                queue[qtail++] = depth;
+            }
+            n++;
+
+            inner += step;
+            if (inner >= bt->len)
+                break;
+        }
+        count[blk] = n;
+    }
+
+    free(queue);
+    ft->bt = bt;
+    ft->width = width;
+    ft->nblocks = nblocks;
+    ft->bounds = (int16_t*) realloc(bounds, sizeof(int16_t) * nblocks * 12 * width);
+    ft->child = (int32_t*) realloc(child, sizeof(int32_t) * nblocks * width);
+    ft->count = (uint8_t*) realloc(count, sizeof(uint8_t) * nblocks);
+    return 1;
+
+L_fail:
+    free(bounds);
+    free(child);
+    free(count);
+    free(queue);
+    return 0;
+}
+
+void freeBiomeTreeFlat(BiomeTreeFlat *ft)
+{
+    free(ft->bounds);
+    free(ft->child);
+    free(ft->count);
+    memset(ft, 0, sizeof(*ft));
+}
+
+/* Squared distances from the noise point to all children of a block.
+ * The arithmetic is the same as in get_np_dist(), including the wrap-around,
+ * as long as the noise parameters are within +/-2^30.
+ */
+static inline
+void get_block_dist(const BiomeTreeFlat *ft, int blk, const int32_t np[6],
+    uint64_t *ds)
+{
+    const int width = ft->width;
+    const int16_t *lo = ft->bounds + blk * 12 * width;
+    const int16_t *hi = lo + 6 * width;
+    int n = ft->count[blk];
+    int i, j;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    const __m128i zero = _mm_setzero_si128();
+    for (i = 0; i < n; i += 4)
+    {
+        __m128i even = zero, odd = zero;
+        for (j = 0; j < 6; j++)
+        {
+            __m128i v = _mm_set1_epi32(np[j]);
+            __m128i l = _mm_loadl_epi64((const __m128i*)(lo + j*width + i));
+            __m128i h = _mm_loadl_epi64((const __m128i*)(hi + j*width + i));
+            l = _mm_srai_epi32(_mm_unpacklo_epi16(l, l), 16);
+            h = _mm_srai_epi32(_mm_unpacklo_epi16(h, h), 16);
+            __m128i a = _mm_sub_epi32(v, h);
+            __m128i b = _mm_sub_epi32(l, v);
+            a = _mm_and_si128(a, _mm_cmpgt_epi32(a, zero));
+            b = _mm_and_si128(b, _mm_cmpgt_epi32(b, zero));
+            __m128i d = _mm_or_si128(a, b); // at most one of a and b is > 0
+            even = _mm_add_epi64(even, _mm_mul_epu32(d, d));
+            d = _mm_srli_epi64(d, 32);
+            odd = _mm_add_epi64(odd, _mm_mul_epu32(d, d));
+        }
+        uint64_t e[2], o[2];
+        _mm_storeu_si128((__m128i*)e, even);
+        _mm_storeu_si128((__m128i*)o, odd);
+        ds[i+0] = e[0];
+        ds[i+1] = o[0];
+        ds[i+2] = e[1];
+        ds[i+3] = o[1];
+    }
+#else
+    for (i = 0; i < n; i++)
+    {
+        uint64_t s = 0;
+        for (j = 0; j < 6; j++)
+        {
+            int64_t a = np[j] - hi[j*width + i];
+            int64_t b = lo[j*width + i] - np[j];
+            uint64_t d = a > 0 ? a : b > 0 ? b : 0;
+            s += d * d;
+        }
+        ds[i] = s;
+    }
+#endif
+}
+
+ATTR(hot)
+int climateToBiomeFlat(const BiomeTreeFlat *ft, const uint64_t np[6], uint64_t *dat)
+{
+    const BiomeTree *bt = ft->bt;
+    int32_t np32[6];
+    int i;
+
+    for (i = 0; i < 6; i++)
+    {
+        int64_t v = (int64_t) np[i];
+        if (v < -(1 << 30) || v > (1 << 30))
+            break;
+        np32[i] = (int32_t) v;
+    }
+    if (i < 6)
+    {   // out of range for 32-bit lanes, use the reference search
+        uint64_t ds = dat ? get_np_dist(np, bt, (int) *dat) : (uint64_t)-1;
+        int idx = get_resulting_node(np, bt, 0, dat ? (int) *dat : 0, ds, 0);
+        if (dat)
+            *dat = (uint64_t) idx;
+        return (bt->nodes[idx] >> 48) & 0xFF;
+    }
+
+    struct {
+        int blk, i;
+        uint64_t ds[16];
+    } stack[8];
+    int sp = 0;
+    int leaf = dat ? (int) *dat : 0;
+    uint64_t best = dat ? get_np_dist(np, bt, leaf) : (uint64_t)-1;
+
+    stack[0].blk = 0;
+    stack[0].i = 0;
+    get_block_dist(ft, 0, np32, stack[0].ds);
+
+    // Iterative depth-first search with the same child order and strict
+    // comparisons as get_resulting_node(), so ties resolve identically.
+    while (sp >= 0)
+    {
+        int blk = stack[sp].blk;
+        i = stack[sp].i++;
+        if (i >= ft->count[blk])
+        {
+            sp--;
+            continue;
+        }
+        uint64_t ds = stack[sp].ds[i];
+        if (ds >= best)
+            continue;
+        int32_t c = ft->child[blk * ft->width + i];
+        if (c < 0)
+        {
+            best = ds;
+            leaf = ~c;
+        }
+        else
+        {
+            sp++;
+            stack[sp].blk = c;
+            stack[sp].i = 0;
+            get_block_dist(ft, c, np32, stack[sp].ds);
+        }
+    }
+
+    if (dat)
+        *dat = (uint64_t) leaf;
+    return (bt->nodes[leaf] >> 48) & 0xFF;
+}
+
+
 void setClimateParaSeed(BiomeNoise *bn, uint64_t seed, int large, int nptype, int nmax)
 {
     Xoroshiro pxr;
@@ -1507,6 +1830,22 @@ void setClimateParaSeed(BiomeNoise *bn, uint64_t seed, int large, int nptype, in
     bn->nptype = nptype;
 }
 
+void setClimateShiftSeed(BiomeNoise *bn, uint64_t seed, int large)
+{
+    Xoroshiro pxr;
+    xSetSeed(&pxr, seed);
+    uint64_t xlo = xNextLong(&pxr);
+    uint64_t xhi = xNextLong(&pxr);
+    init_climate_seed(bn->climate + NP_SHIFT, bn->oct, xlo, xhi, large, NP_SHIFT, -1);
+    bn->nptype = NP_SHIFT;
+}
+
+void getClimateShift(const BiomeNoise *bn, int x, int z, double *px, double *pz)
+{
+    *px = x + sampleDoublePerlin(&bn->climate[NP_SHIFT], x, 0, z) * 4.0;
+    *pz = z + sampleDoublePerlin(&bn->climate[NP_SHIFT], z, x, 0) * 4.0;
+}
+
 double sampleClimatePara(const BiomeNoise *bn, int64_t *np, double x, double z)
 {
     if (bn->nptype == NP_DEPTH)
@@ -1591,7 +1930,7 @@ int genBiomeNoiseScaled(const BiomeNoise *bn, int *out, Range r, uint64_t sha)
         r.sy = 1;
 
     uint64_t siz = (uint64_t)r.sx*r.sy*r.sz;
-    int i, j, k;
+    int i, j, k, n;
 
     if (r.scale == 1)
     {
@@ -1612,20 +1951,26 @@ int genBiomeNoiseScaled(const BiomeNoise *bn, int *out, Range r, uint64_t sha)
         {
             for (j = 0; j < r.sz; j++)
             {
-                for (i = 0; i < r.sx; i++)
+                for (i = 0; i < r.sx; i += 64)
                 {
-                    int x4, z4, y4;
-                    voronoiAccess3D(sha, r.x+i, r.y+k, r.z+j, &x4, &y4, &z4);
-                    if (src)
-                    {
-                        x4 -= s.x; y4 -= s.y; z4 -= s.z;
-                        *p = src[(int64_t)y4*s.sx*s.sz + (int64_t)z4*s.sx + x4];
-                    }
-                    else
+                    int x4[64], y4[64], z4[64], cnt = r.sx - i;
+                    if (cnt > 64)
+                        cnt = 64;
+                    voronoiAccessRow(sha, r.x+i, r.y+k, r.z+j, cnt, x4, y4, z4);
+                    for (n = 0; n < cnt; n++, p++)
                     {
-                        *p = sampleBiomeNoise(bn, 0, x4, y4, z4, 0, 0);
+                        if (src)
+                        {
+                            int64_t xs = x4[n] - s.x;
+                            int64_t ys = y4[n] - s.y;
+                            int64_t zs = z4[n] - s.z;
+                            *p = src[ys*s.sx*s.sz + zs*s.sx + xs];
+                        }
+                        else
+                        {
+                            *p = sampleBiomeNoise(bn, 0, x4[n], y4[n], z4[n], 0, 0);
+                        }
                     }
-                    p++;
                 }
             }
         }
@@ -134,6 +134,8 @@ STRUCT(BiomeNoise)
     SplineStack ss;
     int nptype;
     int mc;
+    const struct BiomeTreeFlat *ft; // optional flattened biome tree (nullable)
+    uint64_t *hint; // optional warm-start node for lookups without 'dat' (nullable)
 };
 // Overworld biome generator for pre-Beta 1.8
 STRUCT(BiomeNoiseBeta)
@@ -154,6 +156,18 @@ STRUCT(BiomeTree)
     uint32_t len;
 };
 
+// Flattened copy of a BiomeTree: the children of each inner node are stored
+// together in one block, with the blocks in breadth-first order.
+STRUCT(BiomeTreeFlat)
+{
+    const BiomeTree *bt;
+    int width;          // children per block, order rounded up to 4
+    int nblocks;
+    int16_t *bounds;    // [nblocks][2][6][width]: lower then upper bounds
+    int32_t *child;     // [nblocks][width]: block of inner child, or ~leaf
+    uint8_t *count;     // [nblocks]: number of children in block
+};
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -218,6 +232,12 @@ int mapEnd(const EndNoise *en, int *out, int x, int z, int w, int h);
 int getEndSurfaceHeight(int mc, uint64_t seed, int x, int z);
 int mapEndSurfaceHeight(float *y, const EndNoise *en, const SurfaceNoise *sn,
     int x, int z, int w, int h, int scale, int ymin);
+/* Samples the End height noise at 8 block cells. The chunk at (cx, cz) has
+ * its biome decided at (2*cx+1, 2*cz+1): highlands above 40, midlands from 0.
+ * Only islands within 'range' cells are considered (0 for the full 12);
+ * a range of 6 already decides whether the height is at least 0.
+ */
+float getEndHeightNoise(const EndNoise *en, int x, int z, int range);
 
 /**
  * The scaled End generation supports scales 1, 4, 16, and 64.
@@ -233,6 +253,13 @@ int genEndScaled(const EndNoise *en, int *out, Range r, int mc, uint64_t sha);
  * The scale is 1:4, and is sampled at each point individually as there is
  * currently not much benefit from generating a volume as a whole.
  *
+ * The 'dat' argument is a warm-start hint for the biome tree search (see
+ * climateToBiome) and makes nearby lookups cheaper. If 'dat' is NULL, the
+ * BiomeNoise.hint pointer is used instead, when set. This lets a caller carry
+ * one hint through all lookups for a seed, including those made internally by
+ * getBiomeAt() and the structure viability checks. Note that a hint can pick a
+ * different biome where two tree leaves are at exactly the same distance.
+ *
  * The 1.18 End generation remains similar to 1.17 and does NOT use the
  * biome noise.
  */
@@ -251,6 +278,18 @@ int sampleBiomeNoiseBeta(const BiomeNoiseBeta *bnb, int64_t *np, double *nv,
 double approxSurfaceBeta(const BiomeNoiseBeta *bnb, const SurfaceNoiseBeta *snb,
     int x, int z); // doesn't really work yet
 
+/**
+ * Approximate biome noise sampling for prefilters, at scale 1:4. Only the
+ * 'noct' lowest frequency octaves of each climate noise are sampled and the
+ * remaining octaves are bounded by their amplitude instead. The output
+ * 'limits' holds conservative min/max values for each noise parameter, in the
+ * order of sampleBiomeNoise() (the depth is left unbounded). Passed to
+ * getPossibleBiomesForLimits(), they give a superset of the biomes that
+ * sampleBiomeNoise() can return at that position.
+ */
+void sampleBiomeNoiseApprox(const BiomeNoise *bn, int limits[6][2],
+    int x, int z, int noct, uint32_t sample_flags);
+
 /**
  * (Alpha 1.2 - Beta 1.7) 
  * Temperature and humidity values to biome.
@@ -263,6 +302,20 @@ int getOldBetaBiome(float t, float h);
  */
 int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat);
 
+/**
+ * Builds a flattened copy of the biome tree for version 'mc', where the
+ * children of a node are stored together so their distances can be computed
+ * at once. The flat tree is read-only after initialization and can be shared
+ * between threads. Assign it to BiomeNoise.ft to make sampleBiomeNoise() use
+ * it. Returns zero if the tree could not be built.
+ *
+ * climateToBiomeFlat() returns the same biome as climateToBiome() and uses the
+ * same node indices for the 'dat' hint, so the two can be mixed freely.
+ */
+int initBiomeTreeFlat(BiomeTreeFlat *ft, int mc);
+void freeBiomeTreeFlat(BiomeTreeFlat *ft);
+int climateToBiomeFlat(const BiomeTreeFlat *ft, const uint64_t np[6], uint64_t *dat);
+
 /**
  * Initialize BiomeNoise for only a single climate parameter.
  * If nptype == NP_DEPTH, the value is sampled at y=0. Note that this value
@@ -273,6 +326,16 @@ int climateToBiome(int mc, const uint64_t np[6], uint64_t *dat);
 void setClimateParaSeed(BiomeNoise *bn, uint64_t seed, int large, int nptype, int nmax);
 double sampleClimatePara(const BiomeNoise *bn, int64_t *np, double x, double z);
 
+/**
+ * Initialize BiomeNoise for only the shift noise, which offsets the position
+ * at which sampleBiomeNoise() samples the climate parameters. Since NP_SHIFT
+ * and NP_DEPTH share an index, this cannot be done with setClimateParaSeed().
+ * getClimateShift() gives the shifted position for the 1:4 scale (x, z), at
+ * which sampleClimatePara() then matches the values of sampleBiomeNoise().
+ */
+void setClimateShiftSeed(BiomeNoise *bn, uint64_t seed, int large);
+void getClimateShift(const BiomeNoise *bn, int x, int z, double *px, double *pz);
+
 /**
  * Currently, in 1.18, we have to generate biomes one chunk at a time to get an
  * accurate mapping of the biomes in the level storage, as there is no longer a
@@ -518,8 +518,6 @@ int mapEndIslandHeight(float *y, const EndNoise *en, uint64_t seed,
     return 0;
 }
 
-float getEndHeightNoise(const EndNoise *en, int x, int z, int range);
-
 int isEndChunkEmpty(const EndNoise *en, const SurfaceNoise *sn, uint64_t seed,
     int chunkX, int chunkZ)
 {
@@ -1059,8 +1057,13 @@ Pos estimateSpawn(const Generator *g, uint64_t *rng)
 
 Pos getSpawn(const Generator *g)
 {
-    uint64_t rng;
+    uint64_t rng = 0;
     Pos spawn = estimateSpawn(g, &rng);
+    return refineSpawn(g, spawn, rng);
+}
+
+Pos refineSpawn(const Generator *g, Pos spawn, uint64_t rng)
+{
     int i, j, k, u, v, cx0, cz0;
     uint32_t ii, jj;
 
@@ -5390,6 +5393,38 @@ L_end:
     return err;
 }
 
+double getParaRangeSlack(const DoublePerlinNoise *para)
+{
+    // Bound on the second directional derivative of a perlin octave, the
+    // largest found by sampling is about 11.7.
+    const double perlin_curv = 16.0;
+    // largest magnitude of (improved) perlin noise, see approxDoublePerlin()
+    const double perlin_max = 1.04;
+    const double lac_factB = 337.0 / 331.0;
+    // squared distance from any point to the nearest integer position
+    const double dist2 = 0.5;
+    const OctaveNoise *oct[2] = { &para->octA, &para->octB };
+    double slack = 0;
+    int i, k;
+
+    // At an extremum inside the area the gradient vanishes, so the nearest
+    // integer position is lower by at most half the curvature times dist2.
+    for (k = 0; k < 2; k++)
+    {
+        for (i = 0; i < oct[k]->octcnt; i++)
+        {
+            const PerlinNoise *p = oct[k]->octaves + i;
+            double lac = p->lacunarity * (k ? lac_factB : 1.0);
+            double amp = fabs(p->amplitude);
+            double s = 0.5 * dist2 * perlin_curv * lac * lac * amp;
+            if (s > 2 * perlin_max * amp)
+                s = 2 * perlin_max * amp;
+            slack += s;
+        }
+    }
+    return 10000 * slack * fabs(para->amplitude);
+}
+
 #define IMIN INT_MIN
 #define IMAX INT_MAX
 static const int g_biome_para_range_18[][13] = {
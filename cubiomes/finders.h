@@ -315,6 +315,12 @@ Pos estimateSpawn(const Generator *g, uint64_t *rng);
  */
 Pos getSpawn(const Generator *g);
 
+/* Second half of getSpawn(): refines the result of estimateSpawn() together
+ * with the random state it output. For 1.18+ the spawn moves at most 95
+ * blocks along each axis from the estimate, for 1.13 - 1.17 at most 271.
+ */
+Pos refineSpawn(const Generator *g, Pos spawn, uint64_t rng);
+
 
 /* Finds a suitable pseudo-random location in the specified area.
  * This function is used to determine the positions of spawn and strongholds.
@@ -714,6 +720,14 @@ double getParaDescent(const DoublePerlinNoise *para, double factor,
 int getParaRange(const DoublePerlinNoise *para, double *pmin, double *pmax,
     int x, int z, int w, int h, void *data, int (*func)(void*,int,int,double));
 
+/**
+ * Bounds how far a climate parameter can exceed the range that getParaRange()
+ * finds over the integer positions of an area, when it is sampled at the
+ * fractional positions in between, as the climate shift does. The area has to
+ * cover the sampled positions. The result has the scale of getParaRange().
+ */
+double getParaRangeSlack(const DoublePerlinNoise *para);
+
 /**
  * Gets the min/max parameter values within which a biome change can occur.
  */
@@ -5,6 +5,18 @@
 #include <math.h>
 #include <float.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LAYERS_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VORONOI_AVX
+#include <immintrin.h>
+#endif
+
 
 //==============================================================================
 // Essentials
@@ -184,6 +196,70 @@ static inline int select4(uint32_t cs, uint32_t st, int v00, int v01, int v10, i
     return v;
 }
 
+#if defined(LAYERS_SSE2)
+// Four lanes of the chunk seed arithmetic, truncated to 32 bits, which is all
+// that the zoom and smooth layers look at (see the scalar code in mapZoom)
+static inline __m128i mul32x4(__m128i a, __m128i b)
+{
+#if defined(__SSE4_1__)
+    return _mm_mullo_epi32(a, b);
+#else
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    even = _mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0));
+    odd = _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0));
+    return _mm_unpacklo_epi32(even, odd);
+#endif
+}
+
+static inline __m128i mcStepSeed32x4(__m128i s, __m128i salt)
+{
+    const __m128i m = _mm_set1_epi32(1284865837);
+    const __m128i a = _mm_set1_epi32((int)4150755663U);
+    return _mm_add_epi32(mul32x4(s, _mm_add_epi32(mul32x4(s, m), a)), salt);
+}
+
+// (m ? a : b) for each lane
+static inline __m128i select32x4(__m128i m, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+// lanes where (cs >> 24) & 1 is set
+static inline __m128i bit24x4(__m128i cs)
+{
+    const __m128i b = _mm_set1_epi32(1 << 24);
+    return _mm_cmpeq_epi32(_mm_and_si128(cs, b), b);
+}
+
+// select4() for four lanes, where cs is the seed before the random choice
+static inline __m128i select4x4(__m128i cs, __m128i st,
+        __m128i v00, __m128i v01, __m128i v10, __m128i v11)
+{
+    // negated counts of the equal neighbours
+    __m128i c00 = _mm_add_epi32(_mm_add_epi32(
+        _mm_cmpeq_epi32(v00, v10), _mm_cmpeq_epi32(v00, v01)),
+        _mm_cmpeq_epi32(v00, v11));
+    __m128i c10 = _mm_add_epi32(
+        _mm_cmpeq_epi32(v10, v01), _mm_cmpeq_epi32(v10, v11));
+    __m128i c01 = _mm_cmpeq_epi32(v01, v11);
+
+    cs = mcStepSeed32x4(cs, st);
+    __m128i r = _mm_and_si128(_mm_srli_epi32(cs, 24), _mm_set1_epi32(3));
+    __m128i v = v11;
+    v = select32x4(_mm_cmpeq_epi32(r, _mm_set1_epi32(2)), v01, v);
+    v = select32x4(_mm_cmpeq_epi32(r, _mm_set1_epi32(1)), v10, v);
+    v = select32x4(_mm_cmpeq_epi32(r, _mm_setzero_si128()), v00, v);
+
+    // in reverse order of precedence
+    v = select32x4(_mm_cmplt_epi32(c01, c00), v01, v);
+    v = select32x4(_mm_cmplt_epi32(c10, c00), v10, v);
+    v = select32x4(_mm_and_si128(_mm_cmplt_epi32(c00, c10),
+        _mm_cmplt_epi32(c00, c01)), v00, v);
+    return v;
+}
+#endif
+
 /// This is the most common layer, and generally the second most performance
 /// critical after mapAddIsland.
 int mapZoom(const Layer * l, int * out, int x, int z, int w, int h)
@@ -207,14 +283,58 @@ int mapZoom(const Layer * l, int * out, int x, int z, int w, int h)
     const uint32_t st = (uint32_t)l->startSalt;
     const uint32_t ss = (uint32_t)l->startSeed;
 
+#if defined(LAYERS_SSE2)
+    const __m128i vss = _mm_set1_epi32((int)ss);
+    const __m128i vst = _mm_set1_epi32((int)st);
+    const __m128i lane2 = _mm_set_epi32(6, 4, 2, 0);
+#endif
+
     for (j = 0; j < pH; j++)
     {
         idx = (j * 2) * newW;
+        i = 0;
 
-        v00 = out[(j+0)*pW];
-        v01 = out[(j+1)*pW];
+#if defined(LAYERS_SSE2)
+        for (; i + 4 <= pW; i += 4, idx += 8)
+        {
+            const int *p0 = out + (j+0)*pW + i;
+            const int *p1 = out + (j+1)*pW + i;
+            __m128i a00 = _mm_loadu_si128((const __m128i*)(p0 + 0));
+            __m128i a10 = _mm_loadu_si128((const __m128i*)(p0 + 1));
+            __m128i a01 = _mm_loadu_si128((const __m128i*)(p1 + 0));
+            __m128i a11 = _mm_loadu_si128((const __m128i*)(p1 + 1));
+            __m128i eq = _mm_and_si128(_mm_cmpeq_epi32(a00, a10),
+                _mm_and_si128(_mm_cmpeq_epi32(a00, a01), _mm_cmpeq_epi32(a00, a11)));
+            __m128i top, bl, br;
+
+            if (_mm_movemask_epi8(eq) == 0xffff)
+            {
+                top = bl = br = a00;
+            }
+            else
+            {
+                __m128i cx = _mm_add_epi32(_mm_set1_epi32((int)((i + pX) * 2)), lane2);
+                __m128i cz = _mm_set1_epi32((int)((j + pZ) * 2));
+                __m128i cs = _mm_add_epi32(vss, cx);
+                cs = mcStepSeed32x4(cs, cz);
+                cs = mcStepSeed32x4(cs, cx);
+                cs = mcStepSeed32x4(cs, cz);
+                bl = select32x4(bit24x4(cs), a01, a00);
+                cs = mcStepSeed32x4(cs, vst);
+                top = select32x4(bit24x4(cs), a10, a00);
+                br = select4x4(cs, vst, a00, a01, a10, a11);
+            }
+            _mm_storeu_si128((__m128i*)(buf + idx + 0), _mm_unpacklo_epi32(a00, top));
+            _mm_storeu_si128((__m128i*)(buf + idx + 4), _mm_unpackhi_epi32(a00, top));
+            _mm_storeu_si128((__m128i*)(buf + idx + newW + 0), _mm_unpacklo_epi32(bl, br));
+            _mm_storeu_si128((__m128i*)(buf + idx + newW + 4), _mm_unpackhi_epi32(bl, br));
+        }
+#endif
 
-        for (i = 0; i < pW; i++, v00 = v10, v01 = v11)
+        v00 = out[(j+0)*pW + i];
+        v01 = out[(j+1)*pW + i];
+
+        for (; i < pW; i++, v00 = v10, v01 = v11)
         {
             v10 = out[i+1 + (j+0)*pW];
             v11 = out[i+1 + (j+1)*pW];
@@ -1324,13 +1444,51 @@ int mapSmooth(const Layer * l, int * out, int x, int z, int w, int h)
     uint64_t ss = l->startSeed;
     uint64_t cs;
 
+#if defined(LAYERS_SSE2)
+    const __m128i vss = _mm_set1_epi32((int)ss);
+    const __m128i lane = _mm_set_epi32(3, 2, 1, 0);
+#endif
+
     for (j = 0; j < h; j++)
     {
         int *vz0 = out + (j+0)*pW;
         int *vz1 = out + (j+1)*pW;
         int *vz2 = out + (j+2)*pW;
+        i = 0;
 
-        for (i = 0; i < w; i++)
+#if defined(LAYERS_SSE2)
+        // only bit 24 of the chunk seed is used, which 32 bits determine;
+        // the output row trails the rows that are still being read
+        for (; i + 4 <= w; i += 4)
+        {
+            __m128i v11 = _mm_loadu_si128((const __m128i*)(vz1 + i+1));
+            __m128i v01 = _mm_loadu_si128((const __m128i*)(vz1 + i+0));
+            __m128i v10 = _mm_loadu_si128((const __m128i*)(vz0 + i+1));
+            __m128i v21 = _mm_loadu_si128((const __m128i*)(vz1 + i+2));
+            __m128i v12 = _mm_loadu_si128((const __m128i*)(vz2 + i+1));
+            __m128i e1 = _mm_cmpeq_epi32(v01, v21);
+            __m128i e2 = _mm_cmpeq_epi32(v10, v12);
+            __m128i keep = _mm_and_si128(_mm_cmpeq_epi32(v11, v01),
+                _mm_cmpeq_epi32(v11, v10));
+            __m128i v = select32x4(e2, v10, select32x4(e1, v01, v11));
+            __m128i both = _mm_andnot_si128(keep, _mm_and_si128(e1, e2));
+
+            if (_mm_movemask_epi8(both))
+            {
+                __m128i cx = _mm_add_epi32(_mm_set1_epi32((int)(i + x)), lane);
+                __m128i cz = _mm_set1_epi32((int)(j + z));
+                __m128i c = _mm_add_epi32(vss, cx);
+                c = mcStepSeed32x4(c, cz);
+                c = mcStepSeed32x4(c, cx);
+                c = mcStepSeed32x4(c, cz);
+                v = select32x4(both, select32x4(bit24x4(c), v10, v01), v);
+            }
+            v = select32x4(keep, v11, v);
+            _mm_storeu_si128((__m128i*)(out + i + j*w), v);
+        }
+#endif
+
+        for (; i < w; i++)
         {
             int v11 = vz1[i+1];
             int v01 = vz1[i+0];
@@ -1758,26 +1916,117 @@ static inline void getVoronoiCell(uint64_t sha, int a, int b, int c,
     *z = (((s >> 24) & 1023) - 512) * 36;
 }
 
+// The voronoi cells around a 1:4 cube are compared in groups of four 1:1
+// positions along x. Each group holds the x-offsets 'ax' and the remaining
+// squared y/z distance 'k' for the eight cell corners; lane l adds l*10240 to
+// the x-offset. Distances stay below 2^37 and are therefore exact as doubles,
+// while ties go to the lowest corner index, like the scalar comparisons.
+typedef void (*voronoi_kernel_t)(const double *ax, const double *k, int n,
+        int *idx);
+
+static void voronoiNearestDefault(const double *ax, const double *k, int n,
+        int *idx)
+{
+    int g, c;
+#if defined(LAYERS_SSE2)
+    const __m128d d01 = _mm_set_pd(10240, 0);
+    const __m128d d23 = _mm_set_pd(30720, 20480);
+    for (g = 0; g < n; g++, ax += 8, k += 8, idx += 4)
+    {
+        __m128d m01 = _mm_set1_pd(DBL_MAX), m23 = m01;
+        __m128d i01 = _mm_setzero_pd(), i23 = i01;
+        for (c = 0; c < 8; c++)
+        {
+            __m128d a = _mm_set1_pd(ax[c]);
+            __m128d b = _mm_set1_pd(k[c]);
+            __m128d v = _mm_set1_pd(c);
+            __m128d r01 = _mm_add_pd(a, d01);
+            __m128d r23 = _mm_add_pd(a, d23);
+            r01 = _mm_add_pd(_mm_mul_pd(r01, r01), b);
+            r23 = _mm_add_pd(_mm_mul_pd(r23, r23), b);
+            __m128d lt01 = _mm_cmplt_pd(r01, m01);
+            __m128d lt23 = _mm_cmplt_pd(r23, m23);
+            m01 = _mm_min_pd(r01, m01);
+            m23 = _mm_min_pd(r23, m23);
+            i01 = _mm_or_pd(_mm_and_pd(lt01, v), _mm_andnot_pd(lt01, i01));
+            i23 = _mm_or_pd(_mm_and_pd(lt23, v), _mm_andnot_pd(lt23, i23));
+        }
+        _mm_storel_epi64((__m128i*)(idx+0), _mm_cvttpd_epi32(i01));
+        _mm_storel_epi64((__m128i*)(idx+2), _mm_cvttpd_epi32(i23));
+    }
+#else
+    for (g = 0; g < n; g++, ax += 8, k += 8, idx += 4)
+    {
+        int l;
+        for (l = 0; l < 4; l++)
+        {
+            double dmin = DBL_MAX;
+            idx[l] = 0;
+            for (c = 0; c < 8; c++)
+            {
+                double r = ax[c] + l * 10240;
+                double d = r*r + k[c];
+                if (d < dmin) { dmin = d; idx[l] = c; }
+            }
+        }
+    }
+#endif
+}
+
+#if defined(VORONOI_AVX)
+ATTR(target("avx"))
+static void voronoiNearestAVX(const double *ax, const double *k, int n,
+        int *idx)
+{
+    const __m256d dx = _mm256_set_pd(30720, 20480, 10240, 0);
+    int g, c;
+    for (g = 0; g < n; g++, ax += 8, k += 8, idx += 4)
+    {
+        __m256d m = _mm256_set1_pd(DBL_MAX);
+        __m256d i = _mm256_setzero_pd();
+        for (c = 0; c < 8; c++)
+        {
+            __m256d r = _mm256_add_pd(_mm256_set1_pd(ax[c]), dx);
+            r = _mm256_add_pd(_mm256_mul_pd(r, r), _mm256_set1_pd(k[c]));
+            __m256d lt = _mm256_cmp_pd(r, m, _CMP_LT_OQ);
+            m = _mm256_min_pd(r, m);
+            i = _mm256_or_pd(_mm256_and_pd(lt, _mm256_set1_pd(c)),
+                _mm256_andnot_pd(lt, i));
+        }
+        _mm_storeu_si128((__m128i*)idx, _mm256_cvttpd_epi32(i));
+    }
+}
+#endif
+
+static voronoi_kernel_t getVoronoiKernel(void)
+{
+#if defined(VORONOI_AVX)
+    if (__builtin_cpu_supports("avx"))
+        return voronoiNearestAVX;
+#endif
+    return voronoiNearestDefault;
+}
+
 void mapVoronoiPlane(uint64_t sha, int *out, int *src,
     int x, int z, int w, int h, int y, int px, int pz, int pw, int ph)
 {
     x -= 2;
     y -= 2;
     z -= 2;
-    int x000, x001, x010, x011, x100, x101, x110, x111;
-    int y000, y001, y010, y011, y100, y101, y110, y111;
-    int z000, z001, z010, z011, z100, z101, z110, z111;
-    int pi, pj, ii, jj, dx, dz, pjz, pix, i4, j4;
-    int v00, v01, v10, v11, v;
+    // cell corners are indexed as (dz << 2) | (dx << 1) | dy, where the two
+    // y-levels are y-1 and y+0
+    int cx[8], cy[8], cz[8], v[4];
+    double ax[32], k[32];
+    int idx[16];
+    int pi, pj, ii, jj, pjz, pix, i4, j4, c;
     int prev_skip;
-    int64_t r;
-    uint64_t d, dmin;
     int i, j;
+    voronoi_kernel_t nearest = getVoronoiKernel();
 
     for (pj = 0; pj < ph-1; pj++)
     {
-        v00 = src[(pj+0)*(int64_t)pw];
-        v10 = src[(pj+1)*(int64_t)pw];
+        v[0] = src[(pj+0)*(int64_t)pw];
+        v[2] = src[(pj+1)*(int64_t)pw];
         pjz = pz + pj;
         j4 = pjz * 4 - z;
         prev_skip = 1;
@@ -1789,12 +2038,12 @@ void mapVoronoiPlane(uint64_t sha, int *out, int *src,
             PREFETCH( out + (pjz * 4 + 2) * (int64_t)w + pi, 1, 1 );
             PREFETCH( out + (pjz * 4 + 3) * (int64_t)w + pi, 1, 1 );
 
-            v01 = src[(pj+0)*(int64_t)pw + (pi+1)];
-            v11 = src[(pj+1)*(int64_t)pw + (pi+1)];
+            v[1] = src[(pj+0)*(int64_t)pw + (pi+1)];
+            v[3] = src[(pj+1)*(int64_t)pw + (pi+1)];
             pix = px + pi;
             i4 = pix * 4 - x;
 
-            if (v00 == v01 && v00 == v10 && v00 == v11)
+            if (v[0] == v[1] && v[0] == v[2] && v[0] == v[3])
             {
                 for (jj = 0; jj < 4; jj++)
                 {
@@ -1804,7 +2053,7 @@ void mapVoronoiPlane(uint64_t sha, int *out, int *src,
                     {
                         i = i4 + ii;
                         if (i < 0 || i >= w) continue;
-                        out[j*(int64_t)w + i] = v00;
+                        out[j*(int64_t)w + i] = v[0];
                     }
                 }
                 prev_skip = 1;
@@ -1812,17 +2061,30 @@ void mapVoronoiPlane(uint64_t sha, int *out, int *src,
             }
             if (prev_skip)
             {
-                getVoronoiCell(sha, pix, y-1, pjz+0, &x000, &y000, &z000);
-                getVoronoiCell(sha, pix, y+0, pjz+0, &x001, &y001, &z001);
-                getVoronoiCell(sha, pix, y-1, pjz+1, &x100, &y100, &z100);
-                getVoronoiCell(sha, pix, y+0, pjz+1, &x101, &y101, &z101);
+                getVoronoiCell(sha, pix, y-1, pjz+0, cx+0, cy+0, cz+0);
+                getVoronoiCell(sha, pix, y+0, pjz+0, cx+1, cy+1, cz+1);
+                getVoronoiCell(sha, pix, y-1, pjz+1, cx+4, cy+4, cz+4);
+                getVoronoiCell(sha, pix, y+0, pjz+1, cx+5, cy+5, cz+5);
                 prev_skip = 0;
             }
-            getVoronoiCell(sha, pix+1, y-1, pjz+0, &x010, &y010, &z010);
-            getVoronoiCell(sha, pix+1, y+0, pjz+0, &x011, &y011, &z011);
-            getVoronoiCell(sha, pix+1, y-1, pjz+1, &x110, &y110, &z110);
-            getVoronoiCell(sha, pix+1, y+0, pjz+1, &x111, &y111, &z111);
+            getVoronoiCell(sha, pix+1, y-1, pjz+0, cx+2, cy+2, cz+2);
+            getVoronoiCell(sha, pix+1, y+0, pjz+0, cx+3, cy+3, cz+3);
+            getVoronoiCell(sha, pix+1, y-1, pjz+1, cx+6, cy+6, cz+6);
+            getVoronoiCell(sha, pix+1, y+0, pjz+1, cx+7, cy+7, cz+7);
 
+            for (jj = 0; jj < 4; jj++)
+            {
+                for (c = 0; c < 8; c++)
+                {
+                    const int A = 40*1024;
+                    const int B = 20*1024;
+                    int64_t ry = cy[c] + (c & 1 ? -B : B);
+                    int64_t rz = cz[c] - (c & 4 ? A : 0) + jj * 10*1024;
+                    ax[jj*8 + c] = cx[c] - (c & 2 ? A : 0);
+                    k[jj*8 + c] = (double) (ry*ry + rz*rz);
+                }
+            }
+            nearest(ax, k, 4, idx);
 
             for (jj = 0; jj < 4; jj++)
             {
@@ -1832,76 +2094,17 @@ void mapVoronoiPlane(uint64_t sha, int *out, int *src,
                 {
                     i = i4 + ii;
                     if (i < 0 || i >= w) continue;
-
-                    const int A = 40*1024;
-                    const int B = 20*1024;
-                    dx = ii * 10*1024;
-                    dz = jj * 10*1024;
-                    dmin = (uint64_t)-1;
-
-                    v = v00;
-                    d = 0;
-                    r = x000 - 0 + dx;  d += r*r;
-                    r = y000 + B;       d += r*r;
-                    r = z000 - 0 + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; }
-                    d = 0;
-                    r = x001 - 0 + dx;  d += r*r;
-                    r = y001 - B;       d += r*r;
-                    r = z001 - 0 + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; }
-
-                    d = 0;
-                    r = x010 - A + dx;  d += r*r;
-                    r = y010 + B;       d += r*r;
-                    r = z010 - 0 + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; v = v01; }
-                    d = 0;
-                    r = x011 - A + dx;  d += r*r;
-                    r = y011 - B;       d += r*r;
-                    r = z011 - 0 + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; v = v01; }
-
-                    d = 0;
-                    r = x100 - 0 + dx;  d += r*r;
-                    r = y100 + B;       d += r*r;
-                    r = z100 - A + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; v = v10; }
-                    d = 0;
-                    r = x101 - 0 + dx;  d += r*r;
-                    r = y101 - B;       d += r*r;
-                    r = z101 - A + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; v = v10; }
-
-                    d = 0;
-                    r = x110 - A + dx;  d += r*r;
-                    r = y110 + B;       d += r*r;
-                    r = z110 - A + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; v = v11; }
-                    d = 0;
-                    r = x111 - A + dx;  d += r*r;
-                    r = y111 - B;       d += r*r;
-                    r = z111 - A + dz;  d += r*r;
-                    if (d < dmin) { dmin = d; v = v11; }
-
-                    out[j*(int64_t)w + i] = v;
+                    out[j*(int64_t)w + i] = v[idx[jj*4 + ii] >> 1];
                 }
             }
 
-            x000 = x010;
-            y000 = y010;
-            z000 = z010;
-            x100 = x110;
-            y100 = y110;
-            z100 = z110;
-            x001 = x011;
-            y001 = y011;
-            z001 = z011;
-            x101 = x111;
-            y101 = y111;
-            z101 = z111;
-            v00 = v01;
-            v10 = v11;
+            for (c = 0; c < 8; c += 4)
+            {
+                cx[c+0] = cx[c+2]; cy[c+0] = cy[c+2]; cz[c+0] = cz[c+2];
+                cx[c+1] = cx[c+3]; cy[c+1] = cy[c+3]; cz[c+1] = cz[c+3];
+            }
+            v[0] = v[1];
+            v[2] = v[3];
         }
     }
 }
@@ -2180,5 +2383,75 @@ void voronoiAccess3D(uint64_t sha, int x, int y, int z, int *x4, int *y4, int *z
     if (z4) *z4 = az;
 }
 
+void voronoiAccessRow(uint64_t sha, int x, int y, int z, int n,
+        int *x4, int *y4, int *z4)
+{
+    enum { GROUPS = 16 };
+    x -= 2;
+    y -= 2;
+    z -= 2;
+    int pY = y >> 2;
+    int pZ = z >> 2;
+    int dy = (y & 3) * 10240;
+    int dz = (z & 3) * 10240;
+    // corners indexed as in voronoiAccess3D(), cached across cubes along x
+    int cx[8], cy[8], cz[8];
+    int pX = 0, cached = 0;
+    double ax[8*GROUPS], k[8*GROUPS];
+    int idx[4*GROUPS], cube[GROUPS];
+    int i, j, g, c, ng;
+    voronoi_kernel_t nearest = getVoronoiKernel();
+
+    for (i = 0; i < n; )
+    {
+        int i0 = i;
+        for (ng = 0; ng < GROUPS && i < n; ng++)
+        {
+            int p = (x + i) >> 2;
+            if (cached && p == pX + 1)
+            {
+                for (c = 0; c < 4; c++)
+                {
+                    cx[c] = cx[c+4]; cy[c] = cy[c+4]; cz[c] = cz[c+4];
+                    getVoronoiCell(sha, p+1, pY + (c >> 1), pZ + (c & 1),
+                        cx+c+4, cy+c+4, cz+c+4);
+                }
+            }
+            else
+            {
+                for (c = 0; c < 8; c++)
+                {
+                    getVoronoiCell(sha, p + (c >> 2), pY + ((c >> 1) & 1),
+                        pZ + (c & 1), cx+c, cy+c, cz+c);
+                }
+            }
+            pX = p;
+            cached = 1;
+
+            for (c = 0; c < 8; c++)
+            {
+                int64_t ry = cy[c] + dy - 40*1024*((c >> 1) & 1);
+                int64_t rz = cz[c] + dz - 40*1024*(c & 1);
+                ax[ng*8 + c] = cx[c] - 40*1024*(c >> 2);
+                k[ng*8 + c] = (double) (ry*ry + rz*rz);
+            }
+            cube[ng] = p;
+            i += 4 - ((x + i) & 3);
+        }
+        nearest(ax, k, ng, idx);
+
+        for (g = -1, j = i0; j < i && j < n; j++)
+        {
+            int l = (x + j) & 3;
+            if (j == i0 || l == 0)
+                g++;
+            c = idx[g*4 + l];
+            if (x4) x4[j] = cube[g] + (c >> 2);
+            if (y4) y4[j] = pY + ((c >> 1) & 1);
+            if (z4) z4[j] = pZ + (c & 1);
+        }
+    }
+}
+
 
 
@@ -179,6 +179,13 @@ ATTR(const)
 uint64_t getVoronoiSHA(uint64_t worldSeed);
 void voronoiAccess3D(uint64_t sha, int x, int y, int z, int *x4, int *y4, int *z4);
 
+// Performs voronoiAccess3D() for the 'n' consecutive positions (x+i, y, z)
+// along a row, writing the results to the arrays x4, y4 and z4 (each may be
+// NULL). Neighbouring positions share their cell hashes and the distances are
+// compared several positions at a time, using AVX where the CPU supports it.
+void voronoiAccessRow(uint64_t sha, int x, int y, int z, int n,
+        int *x4, int *y4, int *z4);
+
 // Applies a 2D voronoi mapping at height 'y' to a 'src' plane, where
 // src_range [px,pz,pw,ph] -> out_range [x,z,w,h] have to match the scaling.
 void mapVoronoiPlane(uint64_t sha, int *out, int *src,
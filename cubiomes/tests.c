@@ -221,6 +221,87 @@ int testGeneration()
 }
 
 
+struct _bt_para { const BiomeTreeFlat *ft; int mc; int n; uint64_t (*np)[6]; };
+
+int64_t _bt_ref(int64_t n, void *data)
+{
+    struct _bt_para *d = (struct _bt_para*) data;
+    int64_t i, r = 0;
+    for (i = 0; i < n; i++)
+        r += climateToBiome(d->mc, d->np[i % d->n], NULL);
+    return r;
+}
+
+int64_t _bt_flat(int64_t n, void *data)
+{
+    struct _bt_para *d = (struct _bt_para*) data;
+    int64_t i, r = 0;
+    for (i = 0; i < n; i++)
+        r += climateToBiomeFlat(d->ft, d->np[i % d->n], NULL);
+    return r;
+}
+
+/* Checks that the flattened biome tree agrees with climateToBiome() on
+ * sampled climates, with and without the warm-start hint, and compares the
+ * time per lookup.
+ */
+int testBiomeTreeFlat(int mc)
+{
+    enum { N = 1 << 16 };
+    uint64_t (*np)[6] = (uint64_t(*)[6]) malloc(sizeof(*np) * N);
+    Generator g;
+    BiomeTreeFlat ft;
+    int i, j, bad = 0;
+
+    if (!initBiomeTreeFlat(&ft, mc))
+    {
+        printf("  MC %-6s: failed to build flat biome tree\n", mc2str(mc));
+        free(np);
+        return 0;
+    }
+    setupGenerator(&g, mc, 0);
+    for (i = 0; i < N; i++)
+    {
+        if ((i & 1023) == 0)
+            applySeed(&g, DIM_OVERWORLD, hash32(i));
+        int x = (i & 31) * 8 + (hash32(i >> 10) & 0xfff);
+        int z = ((i >> 5) & 31) * 8;
+        int y = (int)(hash32(i) % 96) - 16;
+        sampleBiomeNoise(&g.bn, (int64_t*) np[i], x, y, z, NULL, SAMPLE_NO_BIOME);
+    }
+
+    uint64_t dat0 = 0, dat1 = 0;
+    for (i = 0; i < N; i++)
+    {
+        int b0 = climateToBiome(mc, np[i], NULL);
+        int b1 = climateToBiomeFlat(&ft, np[i], NULL);
+        int b2 = climateToBiome(mc, np[i], &dat0);
+        int b3 = climateToBiomeFlat(&ft, np[i], &dat1);
+        if (b0 != b1 || b2 != b3 || dat0 != dat1)
+        {
+            if (bad++ < 8)
+            {
+                printf("  mismatch:");
+                for (j = 0; j < 6; j++)
+                    printf(" %" PRId64, (int64_t) np[i][j]);
+                printf(" -> %d %d (hinted: %d %d)\n", b0, b1, b2, b3);
+            }
+        }
+    }
+
+    struct _bt_para d = { &ft, mc, N, np };
+    double tref, tflat;
+    benchmark(_bt_ref, &d, &tref, NULL);
+    benchmark(_bt_flat, &d, &tflat, NULL);
+    printf("  MC %-6s: %d blocks, %d mismatches, %.1f -> %.1f ns/lookup (%.2fx)\n",
+        mc2str(mc), ft.nblocks, bad, tref*1e9, tflat*1e9, tref / tflat);
+
+    freeBiomeTreeFlat(&ft);
+    free(np);
+    return bad == 0;
+}
+
+
 int k_tot;
 struct _f_para { double v; double *buf; int x, z, w, h; };
 int _f1(void *data, int x, int z, double v)
@@ -366,6 +447,454 @@ void findBiomeParaBounds()
     }
 }
 
+/* Compares the biome tiles pruned on their climate ranges, widened by the
+ * shift and by getParaRangeSlack(), with the biomes actually generated in them.
+ * A pruned tile that contains its biome is a false negative of the pruning.
+ * The climate sampled at each cell is also checked against the widened ranges,
+ * as a biome rarely depends on the few cells near the bounds.
+ */
+int testBiomeTilePruning(int mc, int nseeds)
+{
+    static const int biomes[] = {
+        mushroom_fields, jungle, sparse_jungle, badlands, desert, dark_forest,
+        birch_forest, snowy_plains, ice_spikes, cherry_grove, deep_ocean,
+        warm_ocean, beach, stony_shore, river, swamp, mangrove_swamp, meadow,
+    };
+    static const int order[] = {
+        NP_CONTINENTALNESS, NP_TEMPERATURE, NP_HUMIDITY, NP_EROSION, NP_WEIRDNESS
+    };
+    Generator g;
+    setupGenerator(&g, mc, 0);
+    const int *ext = getBiomeParaExtremes(mc);
+    int *ids = NULL;
+    long tiles = 0, pruned = 0, falseneg = 0, outside = 0;
+    int s, k, n, i, j;
+
+    for (s = 0; s < nseeds; s++)
+    {
+        uint64_t seed = ((uint64_t)hash32(s) << 32) ^ hash32(s + 0x9e37);
+        applySeed(&g, DIM_OVERWORLD, seed);
+
+        const DoublePerlinNoise *shift = &g.bn.climate[NP_SHIFT];
+        double amp = 0;
+        for (i = 0; i < shift->octA.octcnt; i++)
+            amp += fabs(shift->octA.octaves[i].amplitude);
+        for (i = 0; i < shift->octB.octcnt; i++)
+            amp += fabs(shift->octB.octaves[i].amplitude);
+        int margin = (int) ceil(4.0 * 1.04 * amp * fabs(shift->amplitude));
+
+        int size = (s & 1) ? 64 : 16;
+        int x = (int)(hash32(3*s+1) % 20000) - 10000;
+        int z = (int)(hash32(3*s+2) % 20000) - 10000;
+
+        double pmin[NP_MAX], pmax[NP_MAX];
+        for (k = 0; k < 5; k++)
+        {
+            int np = order[k];
+            getParaRange(&g.bn.climate[np], &pmin[np], &pmax[np],
+                x - margin, z - margin, size + 2*margin, size + 2*margin,
+                NULL, NULL);
+            double slack = getParaRangeSlack(&g.bn.climate[np]) + 1;
+            pmin[np] -= slack;
+            pmax[np] += slack;
+        }
+
+        for (j = 0; j < size; j++)
+        {
+            for (i = 0; i < size; i++)
+            {
+                int64_t np[NP_MAX];
+                sampleBiomeNoise(&g.bn, np, x+i, 319>>2, z+j, NULL,
+                    SAMPLE_NO_BIOME | SAMPLE_NO_DEPTH);
+                for (k = 0; k < 5; k++)
+                {
+                    int p = order[k];
+                    if (np[p] < pmin[p] || np[p] > pmax[p])
+                        outside++;
+                }
+            }
+        }
+
+        Range r = {4, x, z, size, size, 319>>2, 1};
+        free(ids);
+        ids = allocCache(&g, r);
+        genBiomes(&g, ids, r);
+
+        for (n = 0; n < (int)(sizeof(biomes)/sizeof(*biomes)); n++)
+        {
+            const int *lim = getBiomeParaLimits(mc, biomes[n]);
+            if (!lim)
+                continue;
+            int cut = 0;
+            for (k = 0; k < 5 && !cut; k++)
+            {
+                int np = order[k];
+                if (lim[2*np+0] <= ext[2*np+0] && lim[2*np+1] >= ext[2*np+1])
+                    continue;
+                cut = pmax[np] < lim[2*np+0] || pmin[np] > lim[2*np+1];
+            }
+            int present = 0;
+            for (i = 0; i < size*size && !present; i++)
+                present = ids[i] == biomes[n];
+
+            tiles++;
+            pruned += cut;
+            if (cut && present)
+            {
+                falseneg++;
+                printf("seed:%" PRId64 " tile:(%d %d %d) pruned %s\n",
+                    (int64_t)seed, x, z, size, biome2str(mc, biomes[n]));
+            }
+        }
+    }
+    free(ids);
+
+    int ok = falseneg == 0 && outside == 0;
+    printf("Biome tile pruning for MC %s: %ld of %ld tiles pruned, %ld false "
+        "negatives, %ld parameters outside the bounds, %s!\n", mc2str(mc),
+        pruned, tiles, falseneg, outside, ok ? "PASSED" : "FAILED");
+    return ok;
+}
+
+/* Scalar reference versions of mapZoom() and mapSmooth(), as they were before
+ * the layers were vectorized.
+ */
+static int refSelect4(uint32_t cs, uint32_t st, int v00, int v01, int v10, int v11)
+{
+    int v;
+    int cv00 = (v00 == v10) + (v00 == v01) + (v00 == v11);
+    int cv10 = (v10 == v01) + (v10 == v11);
+    int cv01 = (v01 == v11);
+    if (cv00 > cv10 && cv00 > cv01) {
+        v = v00;
+    } else if (cv10 > cv00) {
+        v = v10;
+    } else if (cv01 > cv00) {
+        v = v01;
+    } else {
+        cs *= cs * 1284865837 + 4150755663;
+        cs += st;
+        int r = (cs >> 24) & 3;
+        v = r==0 ? v00 : r==1 ? v10 : r==2 ? v01 : v11;
+    }
+    return v;
+}
+
+static int refMapZoom(const Layer * l, int * out, int x, int z, int w, int h)
+{
+    int pX = x >> 1;
+    int pZ = z >> 1;
+    int64_t pW = ((x + w) >> 1) - pX + 1;
+    int64_t pH = ((z + h) >> 1) - pZ + 1;
+    int64_t i, j;
+
+    int err = l->p->getMap(l->p, out, pX, pZ, pW, pH);
+    if (err != 0)
+        return err;
+
+    int64_t newW = pW * 2;
+    int64_t idx;
+    int v00, v01, v10, v11;
+    int *buf = out + pW * pH;
+
+    const uint32_t st = (uint32_t)l->startSalt;
+    const uint32_t ss = (uint32_t)l->startSeed;
+
+    for (j = 0; j < pH; j++)
+    {
+        idx = (j * 2) * newW;
+
+        v00 = out[(j+0)*pW];
+        v01 = out[(j+1)*pW];
+
+        for (i = 0; i < pW; i++, v00 = v10, v01 = v11)
+        {
+            v10 = out[i+1 + (j+0)*pW];
+            v11 = out[i+1 + (j+1)*pW];
+
+            if (v00 == v01 && v00 == v10 && v00 == v11)
+            {
+                buf[idx] = v00;
+                buf[idx + 1] = v00;
+                buf[idx + newW] = v00;
+                buf[idx + newW + 1] = v00;
+                idx += 2;
+                continue;
+            }
+
+            int chunkX = (i + pX) * 2;
+            int chunkZ = (j + pZ) * 2;
+
+            uint32_t cs = ss;
+            cs += chunkX;
+            cs *= cs * 1284865837 + 4150755663;
+            cs += chunkZ;
+            cs *= cs * 1284865837 + 4150755663;
+            cs += chunkX;
+            cs *= cs * 1284865837 + 4150755663;
+            cs += chunkZ;
+
+            buf[idx] = v00;
+            buf[idx + newW] = (cs >> 24) & 1 ? v01 : v00;
+            idx++;
+
+            cs *= cs * 1284865837 + 4150755663;
+            cs += st;
+            buf[idx] = (cs >> 24) & 1 ? v10 : v00;
+
+            buf[idx + newW] = refSelect4(cs, st, v00, v01, v10, v11);
+
+            idx++;
+        }
+    }
+
+    for (j = 0; j < h; j++)
+    {
+        memmove(&out[j*w], &buf[(j + (z & 1))*newW + (x & 1)], w*sizeof(int));
+    }
+    return 0;
+}
+
+static int refMapSmooth(const Layer * l, int * out, int x, int z, int w, int h)
+{
+    int pX = x - 1;
+    int pZ = z - 1;
+    int64_t pW = w + 2;
+    int64_t pH = h + 2;
+    int64_t i, j;
+
+    int err = l->p->getMap(l->p, out, pX, pZ, pW, pH);
+    if (err != 0)
+        return err;
+
+    uint64_t ss = l->startSeed;
+    uint64_t cs;
+
+    for (j = 0; j < h; j++)
+    {
+        int *vz0 = out + (j+0)*pW;
+        int *vz1 = out + (j+1)*pW;
+        int *vz2 = out + (j+2)*pW;
+
+        for (i = 0; i < w; i++)
+        {
+            int v11 = vz1[i+1];
+            int v01 = vz1[i+0];
+            int v10 = vz0[i+1];
+
+            if (v11 != v01 || v11 != v10)
+            {
+                int v21 = vz1[i+2];
+                int v12 = vz2[i+1];
+                if (v01 == v21 && v10 == v12)
+                {
+                    cs = getChunkSeed(ss, i+x, j+z);
+                    if (cs & (1ULL << 24))
+                        v11 = v10;
+                    else
+                        v11 = v01;
+                }
+                else
+                {
+                    if (v01 == v21) v11 = v01;
+                    if (v10 == v12) v11 = v10;
+                }
+            }
+
+            out[i + j * w] = v11;
+        }
+    }
+    return 0;
+}
+
+/* Compares the layered generation against the same layer stack using the
+ * scalar references for mapZoom() and mapSmooth(), over random seeds, scales
+ * and areas of odd sizes, so the vector loops and their scalar tails are hit.
+ */
+int testLayerKernels(int mc, int nseeds)
+{
+    static const int scales[] = { 1, 4, 16, 64, 256 };
+    Generator g, ref;
+    int s, k, i, diff = 0;
+    setupGenerator(&g, mc, 0);
+    setupGenerator(&ref, mc, 0);
+
+    for (i = 0; i < L_NUM; i++)
+    {
+        Layer *l = ref.ls.layers + i;
+        if (l->getMap == mapZoom)
+            l->getMap = refMapZoom;
+        else if (l->getMap == mapSmooth)
+            l->getMap = refMapSmooth;
+    }
+
+    for (s = 0; s < nseeds && !diff; s++)
+    {
+        uint64_t seed = ((uint64_t)hash32(s) << 32) ^ hash32(~s);
+        applySeed(&g, DIM_OVERWORLD, seed);
+        applySeed(&ref, DIM_OVERWORLD, seed);
+
+        for (k = 0; k < 5; k++)
+        {
+            Range r;
+            r.scale = scales[k];
+            r.x = (int)(hash32(4*s+k) % 4001) - 2000;
+            r.z = (int)(hash32(4*s+k+1) % 4001) - 2000;
+            r.sx = 1 + hash32(4*s+k+2) % 67;
+            r.sz = 1 + hash32(4*s+k+3) % 37;
+            r.y = 15;
+            r.sy = 1;
+
+            int *a = allocCache(&g, r);
+            int *b = allocCache(&ref, r);
+            genBiomes(&g, a, r);
+            genBiomes(&ref, b, r);
+            if (memcmp(a, b, r.sx * r.sz * sizeof(int)) != 0)
+            {
+                printf("seed:%" PRId64 " scale:%d (%d %d %d %d) differs\n",
+                    (int64_t)seed, r.scale, r.x, r.z, r.sx, r.sz);
+                diff = 1;
+            }
+            free(a);
+            free(b);
+        }
+    }
+
+    printf("Vectorized layers for MC %-4s: %s!\n", mc2str(mc),
+        diff ? "FAILED" : "PASSED");
+    return !diff;
+}
+
+/* Scalar reference for mapVoronoiPlane(), as it was before the 4x4 blocks of
+ * each cube were compared with the row kernel.
+ */
+static void refVoronoiCell(uint64_t sha, int a, int b, int c,
+        int *x, int *y, int *z)
+{
+    uint64_t s = sha;
+    s = mcStepSeed(s, a);
+    s = mcStepSeed(s, b);
+    s = mcStepSeed(s, c);
+    s = mcStepSeed(s, a);
+    s = mcStepSeed(s, b);
+    s = mcStepSeed(s, c);
+
+    *x = (((s >> 24) & 1023) - 512) * 36;
+    s = mcStepSeed(s, sha);
+    *y = (((s >> 24) & 1023) - 512) * 36;
+    s = mcStepSeed(s, sha);
+    *z = (((s >> 24) & 1023) - 512) * 36;
+}
+
+static void refMapVoronoiPlane(uint64_t sha, int *out, int *src,
+    int x, int z, int w, int h, int y, int px, int pz, int pw, int ph)
+{
+    x -= 2;
+    y -= 2;
+    z -= 2;
+    // cell offsets indexed as (dz << 2) | (dx << 1) | dy
+    int cx[8], cy[8], cz[8];
+    int pi, pj, ii, jj, c, i, j;
+
+    for (pj = 0; pj < ph-1; pj++)
+    {
+        int pjz = pz + pj;
+        for (pi = 0; pi < pw-1; pi++)
+        {
+            int pix = px + pi;
+            int v[4] = {
+                src[(pj+0)*(int64_t)pw + pi], src[(pj+0)*(int64_t)pw + pi+1],
+                src[(pj+1)*(int64_t)pw + pi], src[(pj+1)*(int64_t)pw + pi+1],
+            };
+            for (c = 0; c < 8; c++)
+            {
+                refVoronoiCell(sha, pix + (c >> 1 & 1), y - 1 + (c & 1),
+                    pjz + (c >> 2), cx+c, cy+c, cz+c);
+            }
+
+            for (jj = 0; jj < 4; jj++)
+            {
+                j = pjz * 4 - z + jj;
+                if (j < 0 || j >= h) continue;
+                for (ii = 0; ii < 4; ii++)
+                {
+                    i = pix * 4 - x + ii;
+                    if (i < 0 || i >= w) continue;
+
+                    const int A = 40*1024;
+                    const int B = 20*1024;
+                    uint64_t d, dmin = (uint64_t)-1;
+                    int64_t r;
+                    int best = 0;
+                    for (c = 0; c < 8; c++)
+                    {
+                        r = cx[c] - (c & 2 ? A : 0) + ii * 10*1024;  d  = r*r;
+                        r = cy[c] + (c & 1 ? -B : B);                d += r*r;
+                        r = cz[c] - (c & 4 ? A : 0) + jj * 10*1024;  d += r*r;
+                        if (d < dmin) { dmin = d; best = c; }
+                    }
+                    out[j*(int64_t)w + i] = v[best >> 1];
+                }
+            }
+        }
+    }
+}
+
+/* Compares voronoiAccessRow() with voronoiAccess3D() for each position of
+ * random rows, and mapVoronoiPlane() with the scalar reference over random
+ * planes, at coordinates out to the world border.
+ */
+int testVoronoiKernels(int nrows)
+{
+    int x4[64], y4[64], z4[64];
+    int src[20*20], a[67*67], b[67*67];
+    int t, i, diff = 0;
+
+    for (t = 0; t < nrows && !diff; t++)
+    {
+        uint64_t sha = ((uint64_t)hash32(5*t) << 32) ^ hash32(~(5*t));
+        int x = (int)(hash32(5*t+1) % 60000001) - 30000000;
+        int z = (int)(hash32(5*t+2) % 60000001) - 30000000;
+        int y = (int)(hash32(5*t+3) % 385) - 64;
+        int n = 1 + hash32(5*t+4) % 64;
+
+        voronoiAccessRow(sha, x, y, z, n, x4, y4, z4);
+        for (i = 0; i < n; i++)
+        {
+            int rx, ry, rz;
+            voronoiAccess3D(sha, x+i, y, z, &rx, &ry, &rz);
+            if (rx != x4[i] || ry != y4[i] || rz != z4[i])
+            {
+                printf("row sha:%" PRIx64 " (%d %d %d)+%d differs\n", sha, x, y, z, i);
+                diff = 1;
+                break;
+            }
+        }
+
+        // planes of a few biomes, so most cubes are not uniform
+        int w = 1 + hash32(7*t) % 67;
+        int h = 1 + hash32(7*t+1) % 67;
+        int px = (x - 2) >> 2, pz = (z - 2) >> 2;
+        int pw = ((x - 2 + w) >> 2) - px + 2;
+        int ph = ((z - 2 + h) >> 2) - pz + 2;
+        for (i = 0; i < pw*ph; i++)
+            src[i] = hash32(t ^ (i << 12)) % 3;
+        // cells outside the cubes of the plane are left as they were
+        memset(a, 0xff, sizeof(a));
+        memset(b, 0xff, sizeof(b));
+        mapVoronoiPlane(sha, a, src, x-2, z-2, w, h, y >> 2, px, pz, pw, ph);
+        refMapVoronoiPlane(sha, b, src, x-2, z-2, w, h, y >> 2, px, pz, pw, ph);
+        if (memcmp(a, b, w * h * sizeof(int)) != 0)
+        {
+            printf("plane sha:%" PRIx64 " (%d %d %d %d) differs\n", sha, x, z, w, h);
+            diff = 1;
+        }
+    }
+
+    printf("Vectorized voronoi access: %s!\n", diff ? "FAILED" : "PASSED");
+    return !diff;
+}
+
 static void canGenerateTest(int mc, int layerId)
 {
     Generator g;
@@ -535,8 +1064,17 @@ int main()
     //testCanBiomesGenerate();
     //testGeneration();
     //findBiomeParaBounds();
-
-    return 0;
+    int ok = 1;
+    ok &= testBiomeTreeFlat(MC_1_18);
+    ok &= testBiomeTreeFlat(MC_1_21);
+    ok &= testBiomeTilePruning(MC_1_21, 400);
+    ok &= testLayerKernels(MC_1_7, 200);
+    ok &= testLayerKernels(MC_1_12, 200);
+    ok &= testLayerKernels(MC_1_16, 200);
+    ok &= testLayerKernels(MC_1_17, 200);
+    ok &= testVoronoiKernels(200000);
+
+    return ok ? 0 : 1;
 }
 
 
@@ -22,6 +22,45 @@ const char* struct2str(int structureType) {
     }
 }
 
+// Compares the proximity bitmap bits of `count` seeds from `start` with a plain search of
+// getBedrockStructurePos() over every region that could be in range.
+int testProximityBitmap(int structureType, int mc, int radius, uint32_t start, uint64_t count) {
+    ProximityBitmap pb;
+    StructureConfig sconf;
+    if (!getBedrockStructureConfig(structureType, mc, &sconf) ||
+        !allocProximityBitmap(&pb, structureType, mc, radius)) {
+        printf("%s bitmap test could not be set up.\n", struct2str(structureType));
+        return 0;
+    }
+    fillProximityBitmap(&pb, start, count);
+
+    const int64_t limit = (int64_t)(radius + 1) * (radius + 1);
+    const int r = radius / (sconf.regionSize * 16) + 2;
+    uint64_t set = 0, errors = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint32_t s = (uint32_t)(start + i);
+        uint64_t seed = (uint64_t)(int64_t)(int32_t)s;
+        int expect = 0;
+        for (int rz = -r; rz <= r && !expect; rz++) {
+            for (int rx = -r; rx <= r && !expect; rx++) {
+                Pos p;
+                expect = getBedrockStructurePos(structureType, mc, seed, rx, rz, &p) &&
+                         (int64_t)p.x*p.x + (int64_t)p.z*p.z < limit;
+            }
+        }
+        int bit = (pb.bits[s >> 6] >> (s & 63)) & 1;
+        set += bit;
+        if (bit != expect && errors++ < 4)
+            printf("  seed %d: bitmap %d, getBedrockStructurePos() %d\n", (int32_t)s, bit, expect);
+    }
+    freeProximityBitmap(&pb);
+
+    printf("%s within %d: %llu of %llu seeds set, %llu mismatches... %s\n", struct2str(structureType),
+           radius, (unsigned long long)set, (unsigned long long)count, (unsigned long long)errors,
+           errors ? "FAILED!" : "PASSED!");
+    return errors == 0;
+}
+
 int main() {
     const uint64_t SEED = 8675309;
     const int OVERWORLD_STRUCTURES[] = {
@@ -110,5 +149,28 @@ int main() {
         }
     }
 
-    return 0;
+    // Samples of the seed space, including both ends and the sign change of the 32-bit seeds
+    printf("\n=== PROXIMITY BITMAPS ===\n");
+    const uint32_t SAMPLE_STARTS[] = { 0, 0x7fffe000u, 0x9e377980u, 0xffffe000u };
+    const uint64_t SAMPLE_SIZE = 8192;
+    const struct { int type, radius; } BITMAP_TESTS[] = {
+        { Village, 160 },
+        { Swamp_Hut, 192 },
+        { Shipwreck, 96 },
+        { Monument, 256 },
+        { Mansion, 480 },
+        { Outpost, 384 },
+        { Bastion, 192 },
+        { Fortress, 192 },
+        { End_City, 1060 },
+    };
+    int passed = 1;
+    for (size_t i = 0; i < sizeof(BITMAP_TESTS)/sizeof(*BITMAP_TESTS); ++i) {
+        for (size_t j = 0; j < sizeof(SAMPLE_STARTS)/sizeof(*SAMPLE_STARTS); ++j) {
+            passed &= testProximityBitmap(BITMAP_TESTS[i].type, MC_NEWEST, BITMAP_TESTS[i].radius,
+                                          SAMPLE_STARTS[j], SAMPLE_SIZE);
+        }
+    }
+
+    return passed ? 0 : 1;
 }
\ No newline at end of file